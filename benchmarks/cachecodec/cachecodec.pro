@@ -0,0 +1,16 @@
+# Weighs LocalCacheCodec decode time against the storage I/O it saves on saved responses:
+# qmake && make && ./cachecodec <fixture directory or files...>
+
+CONFIG += release c++11 console
+CONFIG -= app_bundle rtti exceptions
+TEMPLATE = app
+TARGET = cachecodec
+QT = core
+
+DEFINES *= QT_NO_DEBUG_OUTPUT
+DEFINES *= QT_USE_QSTRINGBUILDER
+DEFINES *= QT_STRICT_ITERATORS
+
+include(../../src/http/http.pri)
+
+SOURCES += main.cpp
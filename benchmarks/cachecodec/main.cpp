@@ -0,0 +1,108 @@
+#include "localcachecodec.h"
+#include "replayhttp.h"
+#include <QtCore>
+
+namespace {
+
+// Decoding is repeated to get past the timer resolution
+const int decodeIterations = 20;
+
+struct Entry {
+    QByteArray key;
+    QByteArray value;
+};
+
+void addFile(const QString &fileName, QVector<Entry> &entries) {
+    // ReplayHttp fixtures are keyed by URL, like CachedHttp entries
+    ReplayHttp::Fixture fixture;
+    if (ReplayHttp::loadFixture(fileName, fixture)) {
+        if (fixture.status != 200 || fixture.body.isEmpty()) return;
+        Entry entry;
+        entry.key = fixture.url.toEncoded();
+        entry.value = fixture.body;
+        entries << entry;
+        return;
+    }
+    // any other file is a raw response
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) return;
+    Entry entry;
+    entry.key = fileName.toUtf8();
+    entry.value = file.readAll();
+    if (!entry.value.isEmpty()) entries << entry;
+}
+}
+
+int main(int argc, char **argv) {
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    QTextStream out(stdout);
+    if (args.size() < 2) {
+        out << "Usage: " << args.at(0) << " <fixture directory or response files...>\n";
+        return 1;
+    }
+
+    QVector<Entry> entries;
+    for (int i = 1; i < args.size(); ++i) {
+        const QFileInfo info(args.at(i));
+        if (!info.isDir()) {
+            addFile(info.filePath(), entries);
+            continue;
+        }
+        QDirIterator it(info.filePath(), QDir::Files, QDirIterator::Subdirectories);
+        while (it.hasNext())
+            addFile(it.next(), entries);
+    }
+    if (entries.isEmpty()) {
+        out << "No responses found\n";
+        return 1;
+    }
+
+    QElapsedTimer timer;
+    QVector<QByteArray> encoded;
+    encoded.reserve(entries.size());
+    timer.start();
+    for (const Entry &entry : entries)
+        encoded << LocalCacheCodec::encode(entry.key, entry.value);
+    const qint64 encodeNs = timer.nsecsElapsed();
+
+    qint64 rawBytes = 0;
+    qint64 storedBytes = 0;
+    int compressed = 0;
+    for (int i = 0; i < entries.size(); ++i) {
+        const Entry &entry = entries.at(i);
+        const QByteArray &e = encoded.at(i);
+        if (LocalCacheCodec::decode(e, entry.key) != entry.value) {
+            out << "Decoded value differs for " << entry.key << '\n';
+            return 1;
+        }
+        // the codec byte, key size and key are stored either way, compare the rest
+        rawBytes += entry.value.size();
+        storedBytes += e.size() - entry.key.size() - 5;
+        if (e.at(0) == char(LocalCacheCodec::Zlib)) compressed++;
+    }
+
+    int length = 0;
+    timer.start();
+    for (int n = 0; n < decodeIterations; ++n)
+        for (int i = 0; i < entries.size(); ++i)
+            length += LocalCacheCodec::decode(encoded.at(i), entries.at(i).key).size();
+    const qint64 decodeNs = timer.nsecsElapsed() / decodeIterations;
+
+    const qint64 savedBytes = rawBytes - storedBytes;
+    out << entries.size() << " entries, " << compressed << " compressed\n";
+    out << rawBytes << " bytes plain, " << storedBytes << " stored, ratio "
+        << QString::number(double(rawBytes) / qMax(qint64(1), storedBytes), 'f', 2) << '\n';
+    out << "saved: " << savedBytes << " bytes, " << savedBytes / entries.size()
+        << " per entry\n";
+    out << "encode: " << QString::number(encodeNs / 1000.0 / entries.size(), 'f', 1)
+        << " us per entry\n";
+    out << "decode: " << QString::number(decodeNs / 1000.0 / entries.size(), 'f', 1)
+        << " us per entry\n";
+    // reading the saved bytes from a device slower than this costs more than decoding
+    out << "break-even read speed: "
+        << QString::number(double(savedBytes) * 1000 / qMax(qint64(1), decodeNs), 'f', 1)
+        << " MB/s\n";
+    // keeps the loop from being optimized away
+    return length > 0 ? 0 : 1;
+}
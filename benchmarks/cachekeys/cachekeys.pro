@@ -0,0 +1,16 @@
+# Times LocalCache key hashing against SHA1 over recorded request URLs and counts collisions:
+# qmake && make && ./cachekeys <URL list or fixture directory...> [-i iterations]
+
+CONFIG += release c++11 console
+CONFIG -= app_bundle rtti exceptions
+TEMPLATE = app
+TARGET = cachekeys
+QT = core
+
+DEFINES *= QT_NO_DEBUG_OUTPUT
+DEFINES *= QT_USE_QSTRINGBUILDER
+DEFINES *= QT_STRICT_ITERATORS
+
+include(../../src/http/http.pri)
+
+SOURCES += main.cpp
@@ -0,0 +1,119 @@
+#include "cachedhttp.h"
+#include "localcache.h"
+#include "replayhttp.h"
+#include <QtCore>
+
+namespace {
+
+void addUrl(const QUrl &url, QSet<QByteArray> &keys) {
+    // normalized as HttpUtils::ytCache() does
+    static CacheKeyNormalizer *normalizer = [] {
+        CacheKeyNormalizer *n = new CacheKeyNormalizer();
+        n->ignoreQueryItem(QStringLiteral("key"), QStringLiteral("/youtube/v3/"));
+        return n;
+    }();
+    // and keyed as CachedHttp::requestKey() does for a GET
+    if (url.isValid()) keys << normalizer->normalize(url).toEncoded() + "||0";
+}
+
+void addFile(const QString &fileName, QSet<QByteArray> &keys) {
+    ReplayHttp::Fixture fixture;
+    if (ReplayHttp::loadFixture(fileName, fixture)) {
+        addUrl(fixture.url, keys);
+        return;
+    }
+    // otherwise a list of URLs, one per line
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) return;
+    while (!file.atEnd()) {
+        const QByteArray line = file.readLine().trimmed();
+        if (!line.isEmpty()) addUrl(QUrl::fromEncoded(line), keys);
+    }
+}
+
+quint64 sha1Hash64(const QByteArray &key) {
+    const QByteArray digest = QCryptographicHash::hash(key, QCryptographicHash::Sha1);
+    return qFromLittleEndian<quint64>(reinterpret_cast<const uchar *>(digest.constData()));
+}
+
+template <typename Hash> int collisions(const QVector<QByteArray> &keys, Hash hash) {
+    QSet<quint64> hashes;
+    hashes.reserve(keys.size());
+    for (const QByteArray &key : keys)
+        hashes << hash(key);
+    return keys.size() - hashes.size();
+}
+}
+
+class CacheKeyBenchmark {
+public:
+    static int run(const QVector<QByteArray> &keys, int iterations, QTextStream &out);
+};
+
+int CacheKeyBenchmark::run(const QVector<QByteArray> &keys, int iterations, QTextStream &out) {
+    qint64 keyBytes = 0;
+    for (const QByteArray &key : keys)
+        keyBytes += key.size();
+
+    QElapsedTimer timer;
+    quint64 sum = 0;
+
+    timer.start();
+    for (int i = 0; i < iterations; ++i)
+        for (const QByteArray &key : keys)
+            sum += LocalCache::hash64(key);
+    const qint64 murmurNs = timer.nsecsElapsed();
+
+    timer.start();
+    for (int i = 0; i < iterations; ++i)
+        for (const QByteArray &key : keys)
+            sum += sha1Hash64(key);
+    const qint64 sha1Ns = timer.nsecsElapsed();
+
+    const qint64 calls = qint64(iterations) * keys.size();
+    out << keys.size() << " keys, " << keyBytes / keys.size() << " bytes on average, "
+        << iterations << " iterations\n";
+    out << "MurmurHash64A: " << murmurNs / calls << " ns per key, "
+        << collisions(keys, LocalCache::hash64) << " collisions\n";
+    out << "SHA1 (64 bits): " << sha1Ns / calls << " ns per key, "
+        << collisions(keys, sha1Hash64) << " collisions\n";
+    out << "speedup: " << QString::number(double(sha1Ns) / qMax(qint64(1), murmurNs), 'f', 1)
+        << "x\n";
+    // keeps the loops from being optimized away
+    return sum != 0 ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    QCoreApplication app(argc, argv);
+    QStringList args = app.arguments();
+    QTextStream out(stdout);
+
+    int iterations = 100;
+    const int option = args.indexOf(QStringLiteral("-i"));
+    if (option > 0 && option + 1 < args.size()) {
+        iterations = qMax(1, args.at(option + 1).toInt());
+        args.erase(args.begin() + option, args.begin() + option + 2);
+    }
+    if (args.size() < 2) {
+        out << "Usage: " << args.at(0)
+            << " <URL list or fixture directory...> [-i iterations]\n";
+        return 1;
+    }
+
+    QSet<QByteArray> keys;
+    for (int i = 1; i < args.size(); ++i) {
+        const QFileInfo info(args.at(i));
+        if (!info.isDir()) {
+            addFile(info.filePath(), keys);
+            continue;
+        }
+        QDirIterator it(info.filePath(), QDir::Files, QDirIterator::Subdirectories);
+        while (it.hasNext())
+            addFile(it.next(), keys);
+    }
+    if (keys.isEmpty()) {
+        out << "No URLs found\n";
+        return 1;
+    }
+    return CacheKeyBenchmark::run(keys.toList().toVector(), iterations, out);
+}
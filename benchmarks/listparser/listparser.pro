@@ -0,0 +1,24 @@
+# Times YT3ListParser against a QJsonDocument walk over a saved list response:
+# qmake && make && ./listparser videos.json [iterations]
+
+CONFIG += release c++11 console
+CONFIG -= app_bundle rtti exceptions
+TEMPLATE = app
+TARGET = listparser
+QT = core
+
+DEFINES *= QT_USE_QSTRINGBUILDER
+DEFINES *= QT_STRICT_ITERATORS
+
+SRC = $$PWD/../../src
+INCLUDEPATH += $$SRC
+DEPENDPATH += $$SRC
+
+HEADERS += $$SRC/datautils.h \
+    $$SRC/jsonreader.h \
+    $$SRC/yt3listparser.h
+
+SOURCES += main.cpp \
+    $$SRC/datautils.cpp \
+    $$SRC/jsonreader.cpp \
+    $$SRC/yt3listparser.cpp
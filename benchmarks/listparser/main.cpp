@@ -0,0 +1,117 @@
+#include "datautils.h"
+#include "yt3listparser.h"
+#include <QtCore>
+
+namespace {
+
+// What YT3ListParser did before JsonReader, filling records instead of Video objects
+QVector<YT3VideoRecord> parseDocument(const QByteArray &bytes) {
+    QVector<YT3VideoRecord> records;
+    QJsonDocument doc = QJsonDocument::fromJson(bytes);
+    QJsonObject obj = doc.object();
+
+    const QJsonArray items = obj[QLatin1String("items")].toArray();
+    records.reserve(items.size());
+    for (const QJsonValue &v : items) {
+        QJsonObject item = v.toObject();
+        YT3VideoRecord record;
+
+        QJsonValue id = item[QLatin1String("id")];
+        if (id.isString())
+            record.id = id.toString();
+        else
+            record.id = id.toObject()[QLatin1String("videoId")].toString();
+
+        QJsonObject snippet = item[QLatin1String("snippet")].toObject();
+        if (snippet[QLatin1String("liveBroadcastContent")].toString() != QLatin1String("none"))
+            continue;
+
+        QString publishedAt = snippet[QLatin1String("publishedAt")].toString();
+        record.published = QDateTime::fromString(publishedAt, Qt::ISODate);
+        record.channelId = snippet[QLatin1String("channelId")].toString();
+        record.title = snippet[QLatin1String("title")].toString();
+        record.description = snippet[QLatin1String("description")].toString();
+
+        QJsonObject thumbnails = snippet[QLatin1String("thumbnails")].toObject();
+        QLatin1String url("url");
+        record.thumbnailUrl = thumbnails[QLatin1String("medium")].toObject()[url].toString();
+        record.mediumThumbnailUrl = thumbnails[QLatin1String("high")].toObject()[url].toString();
+        record.largeThumbnailUrl = thumbnails[QLatin1String("standard")].toObject()[url].toString();
+        record.channelTitle = snippet[QLatin1String("channelTitle")].toString();
+
+        QJsonValue contentDetails = item[QLatin1String("contentDetails")];
+        if (contentDetails.isObject()) {
+            QString isoPeriod = contentDetails.toObject()[QLatin1String("duration")].toString();
+            record.duration = DataUtils::parseIsoPeriod(isoPeriod);
+        }
+        QJsonValue statistics = item[QLatin1String("statistics")];
+        if (statistics.isObject())
+            record.viewCount =
+                    statistics.toObject()[QLatin1String("viewCount")].toString().toInt();
+
+        records.append(record);
+    }
+    return records;
+}
+
+bool sameRecords(const QVector<YT3VideoRecord> &a, const QVector<YT3VideoRecord> &b) {
+    if (a.size() != b.size()) return false;
+    for (int i = 0; i < a.size(); ++i) {
+        const YT3VideoRecord &x = a.at(i);
+        const YT3VideoRecord &y = b.at(i);
+        if (x.id != y.id || x.title != y.title || x.description != y.description ||
+            x.channelId != y.channelId || x.channelTitle != y.channelTitle ||
+            x.published != y.published || x.thumbnailUrl != y.thumbnailUrl ||
+            x.mediumThumbnailUrl != y.mediumThumbnailUrl ||
+            x.largeThumbnailUrl != y.largeThumbnailUrl || x.duration != y.duration ||
+            x.viewCount != y.viewCount)
+            return false;
+    }
+    return true;
+}
+}
+
+int main(int argc, char **argv) {
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    QTextStream out(stdout);
+    if (args.size() < 2) {
+        out << "Usage: " << args.at(0) << " <videos or search response.json> [iterations]\n";
+        return 1;
+    }
+
+    QFile file(args.at(1));
+    if (!file.open(QIODevice::ReadOnly)) {
+        out << "Cannot read " << file.fileName() << ": " << file.errorString() << '\n';
+        return 1;
+    }
+    const QByteArray bytes = file.readAll();
+    const int iterations = args.size() > 2 ? qMax(1, args.at(2).toInt()) : 1000;
+
+    const QVector<YT3VideoRecord> expected = parseDocument(bytes);
+    if (!sameRecords(expected, YT3ListParser::parse(bytes).getRecords())) {
+        out << "YT3ListParser and QJsonDocument disagree on " << file.fileName() << '\n';
+        return 1;
+    }
+
+    QElapsedTimer timer;
+    int count = 0;
+
+    timer.start();
+    for (int i = 0; i < iterations; ++i)
+        count += parseDocument(bytes).size();
+    const qint64 documentNs = timer.nsecsElapsed();
+
+    timer.start();
+    for (int i = 0; i < iterations; ++i)
+        count += YT3ListParser::parse(bytes).getRecords().size();
+    const qint64 readerNs = timer.nsecsElapsed();
+
+    out << bytes.size() << " bytes, " << expected.size() << " videos, " << iterations
+        << " iterations\n";
+    out << "QJsonDocument: " << documentNs / iterations / 1000 << " us per parse\n";
+    out << "YT3ListParser: " << readerNs / iterations / 1000 << " us per parse\n";
+    out << "speedup: " << QString::number(double(documentNs) / readerNs, 'f', 2) << "x\n";
+    // keeps the loops from being optimized away
+    return count == 2 * iterations * expected.size() ? 0 : 1;
+}
@@ -0,0 +1,116 @@
+#include "signaturedecryptor.h"
+#include <QtCore>
+
+namespace {
+// Random signatures checked and timed on each run
+const int signatureCount = 100;
+
+QString randomSignature() {
+    // "s" values are dot separated hex groups, about 80 to 90 characters long
+    static const char chars[] = "0123456789ABCDEF";
+    const int length = 80 + qrand() % 12;
+    QString s;
+    s.reserve(length);
+    for (int i = 0; i < length; ++i)
+        s += (i % 9 == 8) ? QLatin1Char('.') : QLatin1Char(chars[qrand() % 16]);
+    return s;
+}
+}
+
+// Uses the same captured snippets and operations as the player would, without caching them
+class SignatureBenchmark {
+public:
+    static int run(const QString &player,
+                   const QString &functionName,
+                   int iterations,
+                   QTextStream &out);
+};
+
+int SignatureBenchmark::run(const QString &player,
+                            const QString &functionName,
+                            int iterations,
+                            QTextStream &out) {
+    QHash<QString, QString> functions;
+    QHash<QString, QString> objects;
+    SignatureDecryptor::captureFunction(functionName, player, functions, objects);
+    if (!functions.contains(functionName)) {
+        out << "Cannot capture " << functionName << '\n';
+        return 1;
+    }
+    QStringList snippets;
+    snippets << objects.values() << functions.values();
+    SignatureDecryptor decryptor(QString(), functionName, snippets);
+    decryptor.ops = SignatureDecryptor::analyze(functionName, functions, objects);
+    if (decryptor.ops.isEmpty()) {
+        out << functionName << " is not made of known operations, only the JS engine runs it\n";
+        return 1;
+    }
+    out << "Operations: " << SignatureDecryptor::opsToString(decryptor.ops) << '\n';
+
+    QJSValue function = decryptor.jsFunction();
+    if (!function.isCallable()) {
+        out << "Cannot evaluate " << functionName << '\n';
+        return 1;
+    }
+
+    qsrand(1);
+    QStringList signatures;
+    for (int i = 0; i < signatureCount; ++i) {
+        const QString s = randomSignature();
+        const QJSValue value = function.call(QJSValueList() << s);
+        if (value.isUndefined() || value.isError()) {
+            out << "JS engine failed on " << s << ": " << value.toString() << '\n';
+            return 1;
+        }
+        const QString native = decryptor.transform(s);
+        if (native != value.toString()) {
+            out << "Native transform disagrees on " << s << ": " << native
+                << " instead of " << value.toString() << '\n';
+            return 1;
+        }
+        signatures << s;
+    }
+
+    QElapsedTimer timer;
+    int length = 0;
+
+    timer.start();
+    for (int i = 0; i < iterations; ++i)
+        for (const QString &s : signatures)
+            length += function.call(QJSValueList() << s).toString().length();
+    const qint64 jsNs = timer.nsecsElapsed();
+
+    timer.start();
+    for (int i = 0; i < iterations; ++i)
+        for (const QString &s : signatures)
+            length += decryptor.transform(s).length();
+    const qint64 nativeNs = timer.nsecsElapsed();
+
+    const qint64 calls = qint64(iterations) * signatures.size();
+    out << signatures.size() << " signatures agree, " << iterations << " iterations\n";
+    out << "JS engine: " << jsNs / calls << " ns per signature\n";
+    out << "native: " << nativeNs / calls << " ns per signature\n";
+    out << "speedup: " << QString::number(double(jsNs) / qMax(qint64(1), nativeNs), 'f', 1)
+        << "x\n";
+    // keeps the loops from being optimized away
+    return length > 0 ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    QTextStream out(stdout);
+    if (args.size() < 3) {
+        out << "Usage: " << args.at(0) << " <player.js> <signature function name> [iterations]\n";
+        return 1;
+    }
+
+    QFile file(args.at(1));
+    if (!file.open(QIODevice::ReadOnly)) {
+        out << "Cannot read " << file.fileName() << ": " << file.errorString() << '\n';
+        return 1;
+    }
+    const QString player = QString::fromUtf8(file.readAll());
+    const int iterations = args.size() > 3 ? qMax(1, args.at(3).toInt()) : 100;
+    return SignatureBenchmark::run(player, args.at(2), iterations, out);
+}
@@ -0,0 +1,27 @@
+# Checks the native signature transform of a saved player against its JS engine and times both:
+# qmake && make && ./signature player.js <signature function name> [iterations]
+
+CONFIG += release c++11 console
+CONFIG -= app_bundle rtti exceptions
+TEMPLATE = app
+TARGET = signature
+QT = core qml
+
+DEFINES *= QT_NO_DEBUG_OUTPUT
+DEFINES *= QT_USE_QSTRINGBUILDER
+DEFINES *= QT_STRICT_ITERATORS
+
+SRC = $$PWD/../../src
+INCLUDEPATH += $$SRC
+DEPENDPATH += $$SRC
+
+include($$SRC/http/http.pri)
+
+HEADERS += $$SRC/constants.h \
+    $$SRC/jsfunctions.h \
+    $$SRC/signaturedecryptor.h
+
+SOURCES += main.cpp \
+    $$SRC/constants.cpp \
+    $$SRC/jsfunctions.cpp \
+    $$SRC/signaturedecryptor.cpp
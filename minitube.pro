@@ -97,8 +97,11 @@ HEADERS += src/video.h \
     src/snapshotpreview.h \
     src/datautils.h \
     src/yt3listparser.h \
+    src/jsonreader.h \
+    src/parseutils.h \
     src/ytchannel.h \
     src/yt3.h \
+    src/yt3batcher.h \
     src/paginatedvideosource.h \
     src/searchwidget.h \
     src/exlineedit.h \
@@ -108,7 +111,9 @@ HEADERS += src/video.h \
     src/clickablelabel.h \
     src/ytvideo.h \
     src/toolbarmenu.h \
-    src/sharetoolbar.h
+    src/sharetoolbar.h \
+    src/streamurlcache.h \
+    src/signaturedecryptor.h
 SOURCES += src/main.cpp \
     src/searchlineedit.cpp \
     src/spacer.cpp \
@@ -172,8 +177,10 @@ SOURCES += src/main.cpp \
     src/snapshotpreview.cpp \
     src/datautils.cpp \
     src/yt3listparser.cpp \
+    src/jsonreader.cpp \
     src/ytchannel.cpp \
     src/yt3.cpp \
+    src/yt3batcher.cpp \
     src/paginatedvideosource.cpp \
     src/exlineedit.cpp \
     src/channellistview.cpp \
@@ -182,7 +189,9 @@ SOURCES += src/main.cpp \
     src/clickablelabel.cpp \
     src/ytvideo.cpp \
     src/toolbarmenu.cpp \
-    src/sharetoolbar.cpp
+    src/sharetoolbar.cpp \
+    src/streamurlcache.cpp \
+    src/signaturedecryptor.cpp
 RESOURCES += resources.qrc
 DESTDIR = build/target/
 OBJECTS_DIR = build/obj/
@@ -27,8 +27,20 @@ $END_LICENSE */
 #ifdef APP_MAC
 #include "macutils.h"
 #endif
+#include "circuitbreaker.h"
 #include "http.h"
 #include "httputils.h"
+#include "yt3.h"
+
+namespace {
+
+bool isBackingOff() {
+    // while YouTube is failing or throttling us don't add to its load
+    CircuitBreaker &circuitBreaker = CircuitBreaker::instance();
+    return circuitBreaker.isOpen(QUrl(YT3::baseUrl()).host()) ||
+           circuitBreaker.isOpen(QStringLiteral("www.youtube.com"));
+}
+}
 
 ChannelAggregator::ChannelAggregator(QObject *parent)
     : QObject(parent), unwatchedCount(-1), running(false), stopped(false), currentChannel(0) {
@@ -88,6 +100,11 @@ void ChannelAggregator::processNextChannel() {
         running = false;
         return;
     }
+    if (isBackingOff()) {
+        qDebug() << "Backing off, will check channels later";
+        finish();
+        return;
+    }
     YTChannel *channel = getChannelToCheck();
     if (channel) {
         checkWebPage(channel);
@@ -139,6 +156,7 @@ void ChannelAggregator::reallyProcessChannel(YTChannel *channel) {
     params->setPublishedAfter(channel->getChecked());
     YTSearch *videoSource = new YTSearch(params);
     connect(videoSource, SIGNAL(gotVideos(QVector<Video *>)), SLOT(videosLoaded(QVector<Video *>)));
+    connect(videoSource, SIGNAL(error(QString)), SLOT(videosError(QString)));
     videoSource->loadVideos(50, 1);
 
     channel->updateChecked();
@@ -189,6 +207,12 @@ void ChannelAggregator::videosLoaded(const QVector<Video *> &videos) {
     QTimer::singleShot(0, this, SLOT(processNextChannel()));
 }
 
+void ChannelAggregator::videosError(const QString &message) {
+    qWarning() << message;
+    sender()->deleteLater();
+    QTimer::singleShot(0, this, SLOT(processNextChannel()));
+}
+
 void ChannelAggregator::updateUnwatchedCount() {
     if (!Database::exists()) return;
     QSqlDatabase db = Database::instance().getConnection();
@@ -50,6 +50,7 @@ signals:
 
 private slots:
     void videosLoaded(const QVector<Video*> &videos);
+    void videosError(const QString &message);
     void processNextChannel();
     void checkWebPage(YTChannel *channel);
     void parseWebPage(const QByteArray &bytes);
@@ -33,10 +33,21 @@ $END_LICENSE */
 #include "extra.h"
 #endif
 #include "channellistview.h"
+#include "cachedhttp.h"
+#include "httputils.h"
+#include "playlistmodel.h"
 
 namespace {
 static const QString sortByKey = "subscriptionsSortBy";
 static const QString showUpdatedKey = "subscriptionsShowUpdated";
+
+SearchParams *channelSearchParams(const QString &channelId) {
+    SearchParams *params = new SearchParams();
+    params->setChannelId(channelId);
+    params->setSortBy(SearchParams::SortByNewest);
+    params->setTransient(true);
+    return params;
+}
 }
 
 ChannelView::ChannelView(QWidget *parent) : View(parent),
@@ -57,6 +68,13 @@ ChannelView::ChannelView(QWidget *parent) : View(parent),
     connect(listView, SIGNAL(contextMenu(QPoint)), SLOT(showContextMenu(QPoint)));
     connect(listView, SIGNAL(viewportEntered()), channelsModel, SLOT(clearHover()));
 
+    prefetchTimer = new QTimer(this);
+    prefetchTimer->setSingleShot(true);
+    prefetchTimer->setInterval(500);
+    connect(prefetchTimer, SIGNAL(timeout()), SLOT(prefetchChannel()));
+    connect(listView, SIGNAL(entered(const QModelIndex &)), SLOT(itemEntered(const QModelIndex &)));
+    connect(listView, SIGNAL(viewportEntered()), prefetchTimer, SLOT(stop()));
+
     layout->addWidget(listView);
 
     setupActions();
@@ -160,6 +178,8 @@ void ChannelView::appear() {
 }
 
 void ChannelView::disappear() {
+    prefetchTimer->stop();
+    if (prefetchGroup) prefetchGroup->abort();
     for (QAction* action : statusActions)
         MainWindow::instance()->showActionInStatusBar(action, false);
 }
@@ -168,11 +188,7 @@ void ChannelView::itemActivated(const QModelIndex &index) {
     ChannelModel::ItemTypes itemType = channelsModel->typeForIndex(index);
     if (itemType == ChannelModel::ItemChannel) {
         YTChannel *channel = channelsModel->channelForIndex(index);
-        SearchParams *params = new SearchParams();
-        params->setChannelId(channel->getChannelId());
-        params->setSortBy(SearchParams::SortByNewest);
-        params->setTransient(true);
-        YTSearch *videoSource = new YTSearch(params);
+        YTSearch *videoSource = new YTSearch(channelSearchParams(channel->getChannelId()));
         videoSource->setAsyncDetails(true);
         emit activated(videoSource);
         channel->updateWatched();
@@ -188,6 +204,23 @@ void ChannelView::itemActivated(const QModelIndex &index) {
     }
 }
 
+void ChannelView::itemEntered(const QModelIndex &index) {
+    prefetchTimer->stop();
+    if (channelsModel->typeForIndex(index) != ChannelModel::ItemChannel) return;
+    YTChannel *channel = channelsModel->channelForIndex(index);
+    if (!channel) return;
+    prefetchChannelId = channel->getChannelId();
+    prefetchTimer->start();
+}
+
+void ChannelView::prefetchChannel() {
+    if (prefetchGroup) prefetchGroup->abort();
+    // the same first page itemActivated() would load
+    YTSearch search(channelSearchParams(prefetchChannelId));
+    const QUrl url = search.firstPageUrl(PlaylistModel::maxItems);
+    prefetchGroup = HttpUtils::prefetch(QList<QUrl>() << url);
+}
+
 void ChannelView::showContextMenu(const QPoint &point) {
     const QModelIndex index = listView->indexAt(point);
     if (!index.isValid()) return;
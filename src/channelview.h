@@ -28,6 +28,7 @@ $END_LICENSE */
 class VideoSource;
 class ChannelModel;
 class ChannelListView;
+class PrefetchGroup;
 
 class ChannelView : public View {
 
@@ -65,6 +66,8 @@ private slots:
     void markAllAsWatched();
     void unwatchedCountChanged(int count);
     void updateQuery(bool transition = false);
+    void itemEntered(const QModelIndex &index);
+    void prefetchChannel();
 
 private:
     void setupActions();
@@ -77,6 +80,11 @@ private:
     SortBy sortBy;
     QAction *markAsWatchedAction;
 
+    // Hovering a channel for a while warms its videos
+    QTimer *prefetchTimer;
+    QString prefetchChannelId;
+    QPointer<PrefetchGroup> prefetchGroup;
+
 };
 
 #endif // CHANNELSVIEW_H
@@ -317,7 +317,7 @@ void DownloadItem::speedCheck() {
         // too slow! retry
         qDebug() << "Retrying...";
         connect(video, SIGNAL(gotStreamUrl(QUrl)), SLOT(gotStreamUrl(QUrl)), Qt::UniqueConnection);
-        video->loadStreamUrl();
+        video->loadStreamUrl(true);
     }
 }
 
@@ -1,16 +1,30 @@
-QT *= network
+QT *= network concurrent
 
 INCLUDEPATH += $$PWD/src
 DEPENDPATH += $$PWD/src
 
 HEADERS += \
     $$PWD/src/cachedhttp.h \
+    $$PWD/src/circuitbreaker.h \
     $$PWD/src/http.h \
+    $$PWD/src/httpstats.h \
     $$PWD/src/localcache.h \
-    $$PWD/src/throttledhttp.h
+    $$PWD/src/localcachecodec.h \
+    $$PWD/src/localcachestorage.h \
+    $$PWD/src/localcachewriter.h \
+    $$PWD/src/replayhttp.h \
+    $$PWD/src/scheduledhttp.h \
+    $$PWD/src/segmentcachestorage.h
 
 SOURCES += \
     $$PWD/src/cachedhttp.cpp \
+    $$PWD/src/circuitbreaker.cpp \
     $$PWD/src/http.cpp \
+    $$PWD/src/httpstats.cpp \
     $$PWD/src/localcache.cpp \
-    $$PWD/src/throttledhttp.cpp
+    $$PWD/src/localcachecodec.cpp \
+    $$PWD/src/localcachestorage.cpp \
+    $$PWD/src/localcachewriter.cpp \
+    $$PWD/src/replayhttp.cpp \
+    $$PWD/src/scheduledhttp.cpp \
+    $$PWD/src/segmentcachestorage.cpp
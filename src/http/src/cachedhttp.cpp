@@ -1,17 +1,32 @@
 #include "cachedhttp.h"
+#include "httpstats.h"
 #include "localcache.h"
 
 namespace {
 
-QByteArray requestHash(const HttpRequest &req) {
+// Failures are keyed on the request as it was sent, not on the normalized key:
+// an item that is ignored for responses, e.g. a rejected API key, can be the cause.
+QByteArray failureKey(const HttpRequest &req) {
     const char sep = '|';
-    QByteArray s = req.url.toEncoded() + sep + req.body + sep + QByteArray::number(req.offset);
-    if (req.operation == QNetworkAccessManager::PostOperation) {
-        s.append(sep);
-        s.append("POST");
-    }
-    return LocalCache::hash(s);
+    return "failure|" + req.url.toEncoded() + sep + req.body + sep +
+           QByteArray::number(req.offset);
 }
+
+// Stands in for a 304 Not Modified response, with the body we already had
+class RevalidatedHttpReply : public HttpReply {
+public:
+    RevalidatedHttpReply(const HttpReply &reply, const QByteArray &body)
+        : reply(reply), bytes(body) {}
+    QUrl url() const { return reply.url(); }
+    int statusCode() const { return 200; }
+    const QList<QNetworkReply::RawHeaderPair> headers() const { return reply.headers(); }
+    QByteArray header(const QByteArray &headerName) const { return reply.header(headerName); }
+    QByteArray body() const { return bytes; }
+
+private:
+    const HttpReply &reply;
+    const QByteArray bytes;
+};
 }
 
 CachedHttpReply::CachedHttpReply(const QByteArray &body, const HttpRequest &req)
@@ -24,25 +39,170 @@ QByteArray CachedHttpReply::body() const {
 }
 
 void CachedHttpReply::emitSignals() {
+    // a streaming consumer can find what it needs and abort here
+    emit chunk(body());
     emit data(body());
     emit finished(*this);
     deleteLater();
 }
 
-WrappedHttpReply::WrappedHttpReply(LocalCache *cache, const QByteArray &key, QObject *httpReply)
-    : QObject(httpReply), cache(cache), key(key), httpReply(httpReply) {
+WrappedHttpReply::WrappedHttpReply(CachedHttp &cachedHttp,
+                                   LocalCache *cache,
+                                   const QByteArray &key,
+                                   const QByteArray &failureKey,
+                                   QObject *httpReply,
+                                   const QByteArray &staleValue)
+    : HttpReply(httpReply), cachedHttp(cachedHttp), cache(cache), key(key),
+      failureKey(failureKey), httpReply(httpReply), users(0), prefetch(false),
+      staleValue(staleValue) {
     connect(httpReply, SIGNAL(data(QByteArray)), SIGNAL(data(QByteArray)));
+    connect(httpReply, SIGNAL(chunk(QByteArray)), SIGNAL(chunk(QByteArray)));
     connect(httpReply, SIGNAL(error(QString)), SIGNAL(error(QString)));
     connect(httpReply, SIGNAL(finished(HttpReply)), SLOT(originFinished(HttpReply)));
 }
 
+QUrl WrappedHttpReply::url() const {
+    HttpReply *origin = qobject_cast<HttpReply *>(httpReply);
+    return origin ? origin->url() : QUrl();
+}
+
+void WrappedHttpReply::abort() {
+    // keep it going while someone is waiting for it
+    if (--users > 0) return;
+    // an identical request made from now on must not attach to this dead reply
+    cachedHttp.removePendingRequest(key, this);
+    blockSignals(true);
+    // the origin is our parent, deleting it deletes us before anything gets cached
+    HttpReply *origin = qobject_cast<HttpReply *>(httpReply);
+    if (origin) origin->abort();
+}
+
 void WrappedHttpReply::originFinished(const HttpReply &reply) {
-    if (reply.isSuccessful()) cache->insert(key, reply.body());
+    if (reply.statusCode() == 304 && !staleValue.isNull()) {
+        qDebug() << "CachedHttp NOT MODIFIED" << reply.url();
+        cache->refresh(key);
+        emit chunk(staleValue);
+        emit data(staleValue);
+        emit finished(RevalidatedHttpReply(reply, staleValue));
+        return;
+    }
+    if (reply.isSuccessful()) {
+        LocalCache::Validators validators;
+        validators.etag = reply.header("ETag");
+        validators.lastModified = reply.header("Last-Modified");
+        cache->insert(key, reply.body(), validators);
+    } else if (cachedHttp.getFailureSeconds(reply.statusCode()) > 0) {
+        const QByteArray failure =
+                QByteArray::number(reply.statusCode()) + ' ' + reply.reasonPhrase().toUtf8();
+        cache->insert(failureKey, failure);
+    }
     emit finished(reply);
 }
 
+PendingHttpReply::PendingHttpReply(WrappedHttpReply *origin)
+    : HttpReply(origin), origin(origin) {
+    connect(origin, SIGNAL(data(QByteArray)), SIGNAL(data(QByteArray)));
+    connect(origin, SIGNAL(chunk(QByteArray)), SIGNAL(chunk(QByteArray)));
+    connect(origin, SIGNAL(error(QString)), SIGNAL(error(QString)));
+    connect(origin, SIGNAL(finished(HttpReply)), SIGNAL(finished(HttpReply)));
+}
+
+void PendingHttpReply::abort() {
+    blockSignals(true);
+    if (origin) {
+        origin->disconnect(this);
+        origin->abort();
+    }
+    deleteLater();
+}
+
+QUrl CacheKeyNormalizer::normalize(const QUrl &url) const {
+    QList<QPair<QString, QString>> items = QUrlQuery(url).queryItems(QUrl::FullyEncoded);
+    const QString path = url.path();
+    for (int i = items.size() - 1; i >= 0; --i) {
+        if (isIgnored(items.at(i).first, path)) items.removeAt(i);
+    }
+    // repeated items keep their relative order
+    std::stable_sort(items.begin(), items.end(),
+                     [](const QPair<QString, QString> &a, const QPair<QString, QString> &b) {
+                         return a.first < b.first;
+                     });
+
+    QString query;
+    for (const auto &item : items) {
+        if (!query.isEmpty()) query += QLatin1Char('&');
+        query += item.first + QLatin1Char('=') + item.second;
+    }
+    QUrl normalized = url;
+    normalized.setFragment(QString());
+    normalized.setQuery(query);
+    return normalized;
+}
+
+void CacheKeyNormalizer::ignoreQueryItem(const QString &name, const QString &pathPrefix) {
+    IgnoredItem item = {name, pathPrefix};
+    ignoredItems.append(item);
+}
+
+bool CacheKeyNormalizer::isIgnored(const QString &name, const QString &path) const {
+    for (const IgnoredItem &item : ignoredItems) {
+        if (item.name == name && path.startsWith(item.pathPrefix)) return true;
+    }
+    return false;
+}
+
 CachedHttp::CachedHttp(Http &http, const char *name)
-    : http(http), cache(LocalCache::instance(name)), cachePostRequests(false) {}
+    : http(http), cache(LocalCache::instance(name)), cachePostRequests(false), staleSeconds(0),
+      keyNormalizer(new CacheKeyNormalizer()), clientErrorSeconds(0), serverErrorSeconds(0) {}
+
+void CachedHttp::setFailureSeconds(int statusClass, uint seconds) {
+    if (statusClass == 4)
+        clientErrorSeconds = seconds;
+    else if (statusClass == 5)
+        serverErrorSeconds = seconds;
+    else
+        qWarning() << "Unsupported status class" << statusClass;
+}
+
+uint CachedHttp::getFailureSeconds(int statusCode) const {
+    // these depend on the client, not on the resource
+    if (statusCode == 401 || statusCode == 403 || statusCode == 407 || statusCode == 408 ||
+        statusCode == 429)
+        return 0;
+    if (statusCode >= 400 && statusCode < 500) return clientErrorSeconds;
+    if (statusCode >= 500 && statusCode < 600) return serverErrorSeconds;
+    return 0;
+}
+
+HttpReply *CachedHttp::cachedFailure(const HttpRequest &req) {
+    if (clientErrorSeconds == 0 && serverErrorSeconds == 0) return 0;
+    uint age = 0;
+    LocalCache::Validators validators;
+    const QByteArray failure = cache->staleValue(failureKey(req), &age, &validators);
+    if (failure.isNull()) return 0;
+    const int separator = failure.indexOf(' ');
+    const int statusCode = failure.left(separator).toInt();
+    if (age >= getFailureSeconds(statusCode)) return 0;
+    QString reason;
+    if (separator > 0) reason = QString::fromUtf8(failure.mid(separator + 1));
+    return new FailedHttpReply(req.url, reason, statusCode);
+}
+
+void CachedHttp::setKeyNormalizer(CacheKeyNormalizer *value) {
+    delete keyNormalizer;
+    keyNormalizer = value;
+}
+
+QByteArray CachedHttp::requestKey(const HttpRequest &req) const {
+    const char sep = '|';
+    QByteArray s = keyNormalizer->normalize(req.url).toEncoded() + sep + req.body + sep +
+                   QByteArray::number(req.offset);
+    if (req.operation == QNetworkAccessManager::PostOperation) {
+        s.append(sep);
+        s.append("POST");
+    }
+    return s;
+}
 
 void CachedHttp::setMaxSeconds(uint seconds) {
     cache->setMaxSeconds(seconds);
@@ -52,6 +212,10 @@ void CachedHttp::setMaxSize(uint maxSize) {
     cache->setMaxSize(maxSize);
 }
 
+void CachedHttp::setMaxMemory(uint maxMemory) {
+    cache->setMaxMemory(maxMemory);
+}
+
 QObject *CachedHttp::request(const HttpRequest &req) {
     bool cacheable = req.operation == QNetworkAccessManager::GetOperation ||
                      (cachePostRequests && req.operation == QNetworkAccessManager::PostOperation);
@@ -59,12 +223,138 @@ QObject *CachedHttp::request(const HttpRequest &req) {
         qDebug() << "Not cacheable" << req.url;
         return http.request(req);
     }
-    const QByteArray key = requestHash(req);
+    const QByteArray key = requestKey(req);
     const QByteArray value = cache->value(key);
     if (!value.isNull()) {
         qDebug() << "CachedHttp HIT" << req.url;
+        HttpStats::instance().addCacheResult(req.url, true);
         return new CachedHttpReply(value, req);
     }
-    qDebug() << "CachedHttp MISS" << req.url.toString();
-    return new WrappedHttpReply(cache, key, http.request(req));
+
+    HttpReply *failure = cachedFailure(req);
+    if (failure) {
+        qDebug() << "CachedHttp FAILURE" << req.url << failure->statusCode();
+        HttpStats::instance().addCacheResult(req.url, true);
+        return failure;
+    }
+
+    uint age = 0;
+    LocalCache::Validators validators;
+    const QByteArray staleValue = cache->staleValue(key, &age, &validators);
+
+    auto i = pendingRequests.constFind(key);
+    if (!staleValue.isNull() && age < cache->getMaxSeconds() + staleSeconds) {
+        qDebug() << "CachedHttp STALE" << req.url;
+        HttpStats::instance().addCacheResult(req.url, true);
+        if (i == pendingRequests.constEnd())
+            networkRequest(req, key, staleValue, validators.etag, validators.lastModified);
+        return new CachedHttpReply(staleValue, req);
+    }
+
+    // from here on the caller waits for the network
+    HttpStats::instance().addCacheResult(req.url, false);
+
+    if (i != pendingRequests.constEnd()) {
+        qDebug() << "CachedHttp PENDING" << req.url;
+        WrappedHttpReply *reply = i.value();
+        if (reply->isPrefetch()) {
+            // somebody is waiting for it now, in place of the prefetch
+            reply->setPrefetch(false);
+            http.setPriority(reply->url(), req.priority);
+        } else {
+            reply->addUser();
+        }
+        return new PendingHttpReply(reply);
+    }
+
+    WrappedHttpReply *reply;
+    if (!staleValue.isNull() && !validators.isEmpty()) {
+        qDebug() << "CachedHttp REVALIDATE" << req.url.toString();
+        reply = networkRequest(req, key, staleValue, validators.etag, validators.lastModified);
+    } else {
+        qDebug() << "CachedHttp MISS" << req.url.toString();
+        reply = networkRequest(req, key);
+    }
+    reply->addUser();
+    return new PendingHttpReply(reply);
+}
+
+WrappedHttpReply *CachedHttp::networkRequest(const HttpRequest &req,
+                                             const QByteArray &key,
+                                             const QByteArray &staleValue,
+                                             const QByteArray &etag,
+                                             const QByteArray &lastModified) {
+    HttpRequest conditionalReq = req;
+    if (!etag.isEmpty()) conditionalReq.headers.insert("If-None-Match", etag);
+    if (!lastModified.isEmpty()) conditionalReq.headers.insert("If-Modified-Since", lastModified);
+
+    WrappedHttpReply *reply =
+            new WrappedHttpReply(*this, cache, key, failureKey(req), http.request(conditionalReq),
+                                 staleValue);
+    pendingRequests.insert(key, reply);
+    QObject::connect(reply, &WrappedHttpReply::finished,
+                     [this, key, reply] { removePendingRequest(key, reply); });
+    QObject::connect(reply, &QObject::destroyed,
+                     [this, key, reply] { removePendingRequest(key, reply); });
+    return reply;
+}
+
+bool CachedHttp::setPriority(const QUrl &url, HttpRequest::Priority priority) {
+    return http.setPriority(url, priority);
+}
+
+PrefetchGroup *CachedHttp::prefetch(const QList<HttpRequest> &requests,
+                                    HttpRequest::Priority priority) {
+    PrefetchGroup *group = new PrefetchGroup();
+    for (const HttpRequest &req : requests) {
+        if (req.operation != QNetworkAccessManager::GetOperation) continue;
+        const QByteArray key = requestKey(req);
+        if (pendingRequests.contains(key) || cache->contains(key)) continue;
+        qDebug() << "CachedHttp PREFETCH" << req.url;
+        HttpRequest prefetchReq = req;
+        prefetchReq.priority = priority;
+        WrappedHttpReply *reply = networkRequest(prefetchReq, key);
+        reply->setPrefetch(true);
+        reply->addUser();
+        group->add(reply);
+    }
+    group->start();
+    return group;
+}
+
+void CachedHttp::removePendingRequest(const QByteArray &key, QObject *reply) {
+    // A new request for the same key may already be pending, don't remove it
+    auto i = pendingRequests.find(key);
+    if (i != pendingRequests.end() && i.value() == reply) pendingRequests.erase(i);
+}
+
+PrefetchGroup::PrefetchGroup() : pending(0) {}
+
+void PrefetchGroup::add(WrappedHttpReply *reply) {
+    replies << reply;
+    pending++;
+    connect(reply, SIGNAL(finished(HttpReply)), SLOT(replyFinished()));
+}
+
+void PrefetchGroup::start() {
+    // signals are always emitted from the event loop
+    if (pending == 0) QTimer::singleShot(0, this, SLOT(replyFinished()));
+}
+
+void PrefetchGroup::abort() {
+    blockSignals(true);
+    const QVector<QPointer<WrappedHttpReply>> aborted = replies;
+    replies.clear();
+    for (const QPointer<WrappedHttpReply> &reply : aborted) {
+        // a reply that was taken over keeps running for its other users
+        if (reply && reply->isPrefetch()) reply->abort();
+    }
+    deleteLater();
+}
+
+void PrefetchGroup::replyFinished() {
+    pending--;
+    if (pending > 0) return;
+    emit finished();
+    deleteLater();
 }
@@ -4,19 +4,81 @@
 #include "http.h"
 
 class LocalCache;
+class WrappedHttpReply;
+class PrefetchGroup;
+
+/**
+ * @brief Turns request URLs into cache keys.
+ * Query items are sorted so that their order doesn't matter and ignored items,
+ * e.g. API keys, are removed. Subclass it for further normalization.
+ */
+class CacheKeyNormalizer {
+public:
+    virtual ~CacheKeyNormalizer() {}
+    virtual QUrl normalize(const QUrl &url) const;
+    // Query items that don't affect the response.
+    // An empty pathPrefix applies to every URL, otherwise to those with a matching path.
+    void ignoreQueryItem(const QString &name, const QString &pathPrefix = QString());
+
+protected:
+    bool isIgnored(const QString &name, const QString &path) const;
+
+private:
+    struct IgnoredItem {
+        QString name;
+        QString pathPrefix;
+    };
+    QVector<IgnoredItem> ignoredItems;
+};
 
 class CachedHttp : public Http {
 public:
     CachedHttp(Http &http = Http::instance(), const char *name = "http");
     void setMaxSeconds(uint seconds);
     void setMaxSize(uint maxSize);
+    void setMaxMemory(uint maxMemory);
+    // Expired entries younger than maxSeconds + seconds are served immediately
+    // while they're revalidated in the background
+    void setStaleSeconds(uint seconds) { staleSeconds = seconds; }
     void setCachePostRequests(bool value) { cachePostRequests = value; }
+    // Failed responses are cached for this long, per status class (4 for 4xx, 5 for 5xx).
+    // 0, the default, disables it. Authentication and throttling errors are never cached.
+    void setFailureSeconds(int statusClass, uint seconds);
+    uint getFailureSeconds(int statusCode) const;
+    // Takes ownership, by default a plain CacheKeyNormalizer is used
+    void setKeyNormalizer(CacheKeyNormalizer *value);
+    CacheKeyNormalizer &getKeyNormalizer() { return *keyNormalizer; }
     QObject *request(const HttpRequest &req);
+    bool setPriority(const QUrl &url, HttpRequest::Priority priority);
+
+    // Fills the cache without emitting results, requests already cached or pending are skipped.
+    // A regular request for a prefetched URL takes it over at its own priority.
+    // Returns a PrefetchGroup, abort() it to cancel the whole group.
+    PrefetchGroup *prefetch(const QList<HttpRequest> &requests,
+                            HttpRequest::Priority priority = HttpRequest::IdlePriority);
 
 private:
+    friend class WrappedHttpReply;
+    QByteArray requestKey(const HttpRequest &req) const;
+    HttpReply *cachedFailure(const HttpRequest &req);
+    WrappedHttpReply *networkRequest(const HttpRequest &req,
+                                     const QByteArray &key,
+                                     const QByteArray &staleValue = QByteArray(),
+                                     const QByteArray &etag = QByteArray(),
+                                     const QByteArray &lastModified = QByteArray());
+    void removePendingRequest(const QByteArray &key, QObject *reply);
+
     Http &http;
     LocalCache *cache;
     bool cachePostRequests;
+    uint staleSeconds;
+    CacheKeyNormalizer *keyNormalizer;
+    uint clientErrorSeconds;
+    uint serverErrorSeconds;
+
+    // Requests that missed the cache and are still on the wire, keyed by request hash.
+    // Later identical requests attach to these instead of hitting the network again.
+    QHash<QByteArray, WrappedHttpReply *> pendingRequests;
 };
 
 class CachedHttpReply : public HttpReply {
@@ -33,27 +95,86 @@ private slots:
 
 private:
     const QByteArray bytes;
-    const HttpRequest &req;
+    const HttpRequest req;
 };
 
-class WrappedHttpReply : public QObject {
+class WrappedHttpReply : public HttpReply {
     Q_OBJECT
 
 public:
-    WrappedHttpReply(LocalCache *cache, const QByteArray &key, QObject *httpReply);
+    WrappedHttpReply(CachedHttp &cachedHttp,
+                     LocalCache *cache,
+                     const QByteArray &key,
+                     const QByteArray &failureKey,
+                     QObject *httpReply,
+                     const QByteArray &staleValue = QByteArray());
+    QUrl url() const;
+    int statusCode() const { return 200; }
+    QByteArray body() const { return QByteArray(); }
+    // Counts the callers waiting for this reply, each through its own PendingHttpReply
+    void addUser() { ++users; }
+    bool isPrefetch() const { return prefetch; }
+    void setPrefetch(bool value) { prefetch = value; }
 
-signals:
-    void data(const QByteArray &bytes);
-    void error(const QString &message);
-    void finished(const HttpReply &reply);
+public slots:
+    // Drops a user, the request is stopped once nobody is waiting for it
+    void abort();
 
 private slots:
     void originFinished(const HttpReply &reply);
 
 private:
+    CachedHttp &cachedHttp;
     LocalCache *cache;
     QByteArray key;
+    QByteArray failureKey;
     QObject *httpReply;
+    int users;
+    bool prefetch;
+    // What we have in cache when the request is conditional, used on 304 Not Modified
+    QByteArray staleValue;
+};
+
+// What a caller gets for a request that is on the network. Coalesced callers each get their own,
+// so one of them can abort without affecting the others.
+class PendingHttpReply : public HttpReply {
+    Q_OBJECT
+
+public:
+    PendingHttpReply(WrappedHttpReply *origin);
+    QUrl url() const { return origin ? origin->url() : QUrl(); }
+    int statusCode() const { return 200; }
+    QByteArray body() const { return QByteArray(); }
+
+public slots:
+    void abort();
+
+private:
+    QPointer<WrappedHttpReply> origin;
+};
+
+class PrefetchGroup : public QObject {
+    Q_OBJECT
+
+public:
+    PrefetchGroup();
+    void add(WrappedHttpReply *reply);
+    // Emits finished() once all requests are done, deletes itself after that
+    void start();
+
+public slots:
+    // Requests shared with regular callers are not cancelled
+    void abort();
+
+signals:
+    void finished();
+
+private slots:
+    void replyFinished();
+
+private:
+    QVector<QPointer<WrappedHttpReply>> replies;
+    int pending;
 };
 
 #endif // CACHEDHTTP_H
@@ -0,0 +1,76 @@
+#include "circuitbreaker.h"
+
+CircuitBreaker &CircuitBreaker::instance() {
+    static CircuitBreaker *i = new CircuitBreaker();
+    return *i;
+}
+
+CircuitBreaker::CircuitBreaker()
+    : failureThreshold(5), openTime(30000), maxOpenTime(1000 * 60 * 10) {}
+
+CircuitBreaker::State CircuitBreaker::state(const QString &host) {
+    QMutexLocker locker(&mutex);
+    auto i = hosts.constFind(host);
+    if (i == hosts.constEnd() || i->openUntil == 0) return Closed;
+    if (i->trialPending || now() < i->openUntil) return Open;
+    return HalfOpen;
+}
+
+qint64 CircuitBreaker::remainingOpenTime(const QString &host) {
+    QMutexLocker locker(&mutex);
+    auto i = hosts.constFind(host);
+    if (i == hosts.constEnd() || i->openUntil == 0) return 0;
+    return qMax(qint64(0), i->openUntil - now());
+}
+
+bool CircuitBreaker::allowRequest(const QString &host) {
+    QMutexLocker locker(&mutex);
+    auto i = hosts.find(host);
+    if (i == hosts.end() || i->openUntil == 0) return true;
+    const qint64 t = now();
+    if (t < i->openUntil) return false;
+
+    // half open, let a single trial request through.
+    // If its outcome is never reported another trial is allowed after openTime.
+    i->trialPending = true;
+    i->openUntil = t + i->openTime;
+    qDebug() << "Trial request to" << host;
+    return true;
+}
+
+void CircuitBreaker::reportSuccess(const QString &host) {
+    QMutexLocker locker(&mutex);
+    auto i = hosts.find(host);
+    if (i == hosts.end()) return;
+    if (i->openUntil != 0) qDebug() << "Closing circuit for" << host;
+    hosts.erase(i);
+}
+
+void CircuitBreaker::reportFailure(const QString &host) {
+    QMutexLocker locker(&mutex);
+    Host &h = hosts[host];
+    if (h.trialPending) {
+        open(h, host, h.openTime * 2);
+        return;
+    }
+    // requests started before the circuit opened are still failing, that's expected
+    if (now() < h.openUntil) return;
+    if (++h.failures >= failureThreshold) open(h, host, openTime);
+}
+
+void CircuitBreaker::reportThrottled(const QString &host, qint64 openTime) {
+    QMutexLocker locker(&mutex);
+    Host &h = hosts[host];
+    qint64 time = h.trialPending ? h.openTime * 2 : this->openTime;
+    if (openTime > time) time = openTime;
+    if (!h.trialPending && now() + time <= h.openUntil) return;
+    open(h, host, time);
+}
+
+void CircuitBreaker::open(Host &host, const QString &name, qint64 openTime) {
+    host.openTime = qMin(openTime, qint64(maxOpenTime));
+    host.openUntil = now() + host.openTime;
+    host.failures = 0;
+    host.trialPending = false;
+    qWarning() << "Opening circuit for" << name << host.openTime << "ms";
+}
@@ -0,0 +1,54 @@
+#ifndef CIRCUITBREAKER_H
+#define CIRCUITBREAKER_H
+
+#include <QtCore>
+
+/**
+ * @brief Tracks the health of each host so that requests fail fast while a host is unhealthy.
+ * A host opens after a number of consecutive failures, or right away when it throttles us.
+ * Once the open time has passed a single trial request is let through (half open):
+ * if it succeeds the host is closed again, otherwise it opens for twice as long.
+ * Thread-safe.
+ */
+class CircuitBreaker {
+public:
+    enum State { Closed, Open, HalfOpen };
+
+    static CircuitBreaker &instance();
+
+    void setFailureThreshold(int value) { failureThreshold = value; }
+    void setOpenTime(int milliseconds) { openTime = milliseconds; }
+    void setMaxOpenTime(int milliseconds) { maxOpenTime = milliseconds; }
+
+    State state(const QString &host);
+    bool isOpen(const QString &host) { return state(host) == Open; }
+    // Milliseconds until an open host lets a trial request through
+    qint64 remainingOpenTime(const QString &host);
+
+    // Returns false if the request should fail without hitting the network
+    bool allowRequest(const QString &host);
+    void reportSuccess(const QString &host);
+    void reportFailure(const QString &host);
+    // The host asked us to back off, openTime overrides the default when it's longer
+    void reportThrottled(const QString &host, qint64 openTime = 0);
+
+private:
+    CircuitBreaker();
+    struct Host {
+        Host() : failures(0), openUntil(0), openTime(0), trialPending(false) {}
+        int failures;
+        qint64 openUntil;
+        int openTime;
+        bool trialPending;
+    };
+    void open(Host &host, const QString &name, qint64 openTime);
+    static qint64 now() { return QDateTime::currentMSecsSinceEpoch(); }
+
+    QMutex mutex;
+    QHash<QString, Host> hosts;
+    int failureThreshold;
+    int openTime;
+    int maxOpenTime;
+};
+
+#endif // CIRCUITBREAKER_H
@@ -1,4 +1,6 @@
 #include "http.h"
+#include "circuitbreaker.h"
+#include "httpstats.h"
 
 namespace {
 
@@ -20,6 +22,12 @@ QNetworkAccessManager *networkAccessManager() {
 static int defaultReadTimeout = 10000;
 }
 
+int RetryPolicy::delay(int retry) const {
+    const qint64 cap = qMin(qint64(maxDelay), qint64(baseDelay) << qMin(retry, 16));
+    // half fixed, half random
+    return int(cap / 2 + qrand() % (cap / 2 + 1));
+}
+
 Http::Http() : requestHeaders(getDefaultRequestHeaders()), readTimeout(defaultReadTimeout) {}
 
 void Http::setRequestHeaders(const QMap<QByteArray, QByteArray> &headers) {
@@ -60,8 +68,10 @@ void Http::setDefaultReadTimeout(int timeout) {
 QNetworkReply *Http::networkReply(const HttpRequest &req) {
     QNetworkRequest request(req.url);
 
-    QMap<QByteArray, QByteArray> &headers = requestHeaders;
-    if (!req.headers.isEmpty()) headers = req.headers;
+    // per request headers override the defaults
+    QMap<QByteArray, QByteArray> headers = requestHeaders;
+    for (auto i = req.headers.constBegin(); i != req.headers.constEnd(); ++i)
+        headers.insert(i.key(), i.value());
 
     QMap<QByteArray, QByteArray>::const_iterator it;
     for (it = headers.constBegin(); it != headers.constEnd(); ++it)
@@ -94,6 +104,11 @@ QNetworkReply *Http::networkReply(const HttpRequest &req) {
 }
 
 QObject *Http::request(const HttpRequest &req) {
+    if (!CircuitBreaker::instance().allowRequest(req.url.host())) {
+        qDebug() << "Circuit open, failing" << req.url;
+        HttpStats::instance().addRequest(req.url, 0, 0, false);
+        return new FailedHttpReply(req.url, QStringLiteral("Service unavailable, retry later"));
+    }
     return new NetworkHttpReply(req, *this);
 }
 
@@ -145,11 +160,17 @@ QObject *Http::post(const QUrl &url, const QByteArray &body, const QByteArray &c
     return request(req);
 }
 
+void HttpReply::abort() {
+    blockSignals(true);
+    deleteLater();
+}
+
 NetworkHttpReply::NetworkHttpReply(const HttpRequest &req, Http &http)
-    : http(http), req(req), retryCount(0) {
+    : http(http), req(req), retryCount(0), firstByteReceived(false) {
     if (req.url.isEmpty()) {
         qWarning() << "Empty URL";
     }
+    timer.start();
 
     networkReply = http.networkReply(req);
     setParent(networkReply);
@@ -166,6 +187,8 @@ void NetworkHttpReply::setupReply() {
     connect(networkReply, SIGNAL(error(QNetworkReply::NetworkError)),
             SLOT(replyError(QNetworkReply::NetworkError)), Qt::UniqueConnection);
     connect(networkReply, SIGNAL(finished()), SLOT(replyFinished()), Qt::UniqueConnection);
+    if (req.streaming)
+        connect(networkReply, SIGNAL(readyRead()), SLOT(replyReadyRead()), Qt::UniqueConnection);
     connect(networkReply, SIGNAL(downloadProgress(qint64, qint64)),
             SLOT(downloadProgress(qint64, qint64)), Qt::UniqueConnection);
 }
@@ -188,6 +211,10 @@ void NetworkHttpReply::emitError() {
 void NetworkHttpReply::emitFinished() {
     readTimeoutTimer->stop();
 
+    HttpStats &stats = HttpStats::instance();
+    stats.addTime(req.url, HttpStats::TotalTime, timer.elapsed());
+    stats.addRequest(req.url, bytes.size(), retryCount, isSuccessful());
+
     // disconnect to avoid replyFinished() from being called
     networkReply->disconnect();
 
@@ -215,8 +242,18 @@ void NetworkHttpReply::replyFinished() {
         return;
     }
 
+    CircuitBreaker::instance().reportSuccess(req.url.host());
+
     if (isSuccessful()) {
-        bytes = networkReply->readAll();
+        if (req.streaming) {
+            const QByteArray rest = networkReply->readAll();
+            if (!rest.isEmpty()) {
+                bytes += rest;
+                emit chunk(rest);
+            }
+        } else {
+            bytes = networkReply->readAll();
+        }
         emit data(bytes);
 
 #ifndef QT_NO_DEBUG_OUTPUT
@@ -230,27 +267,111 @@ void NetworkHttpReply::replyFinished() {
     emitFinished();
 }
 
+void NetworkHttpReply::replyReadyRead() {
+    // redirects and errors are not streamed
+    if (!isSuccessful()) return;
+    const QByteArray received = networkReply->readAll();
+    if (received.isEmpty()) return;
+    bytes += received;
+    emit chunk(received);
+}
+
 void NetworkHttpReply::replyError(QNetworkReply::NetworkError code) {
     Q_UNUSED(code);
     const int status = statusCode();
-    if (retryCount <= 3 && status >= 500 && status < 600) {
-        qDebug() << "Retrying" << req.url;
-        networkReply->disconnect();
-        networkReply->deleteLater();
-        QNetworkReply *retryReply = http.networkReply(req);
-        setParent(retryReply);
-        networkReply = retryReply;
-        setupReply();
-        retryCount++;
-        readTimeoutTimer->start();
+    const QString host = req.url.host();
+    CircuitBreaker &circuitBreaker = CircuitBreaker::instance();
+    const RetryPolicy &retryPolicy = http.getRetryPolicy();
+
+    bool retryable = false;
+    if (status == 429) {
+        circuitBreaker.reportThrottled(host, retryAfter());
+        retryable = true;
+    } else if (status >= 500 && status < 600) {
+        circuitBreaker.reportFailure(host);
+        retryable = true;
+    } else if (status == 403) {
+        // Google APIs signal throttling and quota errors with a 403
+        const QByteArray reason = errorReason();
+        if (reason == "rateLimitExceeded" || reason == "userRateLimitExceeded") {
+            circuitBreaker.reportThrottled(host, retryAfter());
+            retryable = true;
+        } else {
+            // quota belongs to the API key, not the host: the caller may switch keys
+            circuitBreaker.reportSuccess(host);
+        }
+    } else if (status == 0) {
+        // no response at all
+        circuitBreaker.reportFailure(host);
     } else {
+        // the host is fine, the request is not
+        circuitBreaker.reportSuccess(host);
+    }
+
+    if (retryable && retryCount < retryPolicy.maxRetries) {
+        const qint64 delay = retryAfter();
+        if (delay <= 0) {
+            scheduleRetry(retryPolicy.delay(retryCount));
+            return;
+        }
+        if (delay <= retryPolicy.maxDelay) {
+            scheduleRetry(delay);
+            return;
+        }
+    }
+    emitError();
+}
+
+qint64 NetworkHttpReply::retryAfter() const {
+    const QByteArray value = networkReply->rawHeader("Retry-After");
+    if (value.isEmpty()) return 0;
+    bool ok;
+    const int seconds = value.toInt(&ok);
+    if (ok) return qint64(seconds) * 1000;
+    // or an HTTP date
+    const QDateTime date = QDateTime::fromString(QString::fromLatin1(value), Qt::RFC2822Date);
+    if (!date.isValid()) return 0;
+    return qMax(qint64(0), QDateTime::currentDateTimeUtc().msecsTo(date));
+}
+
+QByteArray NetworkHttpReply::errorReason() {
+    bytes = networkReply->readAll();
+    const QJsonObject error = QJsonDocument::fromJson(bytes).object().value("error").toObject();
+    const QJsonArray errors = error.value("errors").toArray();
+    if (errors.isEmpty()) return QByteArray();
+    return errors.first().toObject().value("reason").toString().toLatin1();
+}
+
+void NetworkHttpReply::scheduleRetry(int delay) {
+    qDebug() << "Retrying" << req.url << "in" << delay << "ms";
+    readTimeoutTimer->stop();
+    // The failed reply is our parent, keep it until the retry starts
+    networkReply->disconnect();
+    retryCount++;
+    QTimer::singleShot(delay, this, SLOT(retry()));
+}
+
+void NetworkHttpReply::retry() {
+    if (!CircuitBreaker::instance().allowRequest(req.url.host())) {
+        // somebody else is probing the host
         emitError();
         return;
     }
+    QNetworkReply *retryReply = http.networkReply(req);
+    setParent(retryReply);
+    networkReply->deleteLater();
+    networkReply = retryReply;
+    bytes.clear();
+    setupReply();
+    readTimeoutTimer->start();
 }
 
 void NetworkHttpReply::downloadProgress(qint64 bytesReceived, qint64 /* bytesTotal */) {
     // qDebug() << "Downloading" << bytesReceived << bytesTotal << networkReply->url();
+    if (bytesReceived > 0 && !firstByteReceived && isSuccessful()) {
+        firstByteReceived = true;
+        HttpStats::instance().addTime(req.url, HttpStats::TimeToFirstByte, timer.elapsed());
+    }
     if (bytesReceived > 0 && readTimeoutTimer->isActive()) {
         readTimeoutTimer->stop();
         disconnect(networkReply, SIGNAL(downloadProgress(qint64, qint64)), this,
@@ -258,26 +379,42 @@ void NetworkHttpReply::downloadProgress(qint64 bytesReceived, qint64 /* bytesTot
     }
 }
 
+void NetworkHttpReply::abort() {
+    qDebug() << "Aborting" << req.url;
+    blockSignals(true);
+    readTimeoutTimer->stop();
+    networkReply->disconnect();
+    networkReply->abort();
+    // this will also delete this object as the QNetworkReply is its parent
+    networkReply->deleteLater();
+}
+
 void NetworkHttpReply::readTimeout() {
     if (!networkReply) return;
+    qDebug() << "Timeout" << req.url;
     networkReply->disconnect();
     networkReply->abort();
-    networkReply->deleteLater();
+    CircuitBreaker::instance().reportFailure(req.url.host());
 
-    if (retryCount > 3 && (networkReply->operation() != QNetworkAccessManager::GetOperation &&
-                           networkReply->operation() != QNetworkAccessManager::HeadOperation)) {
+    const RetryPolicy &retryPolicy = http.getRetryPolicy();
+    if (retryCount >= retryPolicy.maxRetries) {
         emitError();
-        emit finished(*this);
         return;
     }
+    scheduleRetry(retryPolicy.delay(retryCount));
+}
 
-    qDebug() << "Timeout" << req.url;
-    QNetworkReply *retryReply = http.networkReply(req);
-    setParent(retryReply);
-    networkReply = retryReply;
-    setupReply();
-    retryCount++;
-    readTimeoutTimer->start();
+FailedHttpReply::FailedHttpReply(const QUrl &url, const QString &reasonPhrase, int statusCode)
+    : requestUrl(url), reason(reasonPhrase), status(statusCode) {
+    QTimer::singleShot(0, this, SLOT(emitSignals()));
+}
+
+void FailedHttpReply::emitSignals() {
+    QString message = requestUrl.toString() + QLatin1Char(' ');
+    if (status != 0) message += QString::number(status) + QLatin1Char(' ');
+    emit error(message + reason);
+    emit finished(*this);
+    deleteLater();
 }
 
 QUrl NetworkHttpReply::url() const {
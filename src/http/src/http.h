@@ -5,12 +5,33 @@
 
 class HttpRequest {
 public:
-    HttpRequest() : operation(QNetworkAccessManager::GetOperation), offset(0) {}
+    // Most urgent first, see ScheduledHttp
+    enum Priority { HighestPriority, HighPriority, NormalPriority, LowPriority, IdlePriority };
+
+    HttpRequest()
+        : operation(QNetworkAccessManager::GetOperation), offset(0), priority(NormalPriority),
+          streaming(false) {}
     QUrl url;
     QNetworkAccessManager::Operation operation;
     QByteArray body;
     uint offset;
     QMap<QByteArray, QByteArray> headers;
+    Priority priority;
+    // Emit chunk() as the body arrives, data() still carries the whole body at the end
+    bool streaming;
+};
+
+// How failed requests are retried: 5xx responses, throttling and read timeouts
+class RetryPolicy {
+public:
+    RetryPolicy() : maxRetries(3), baseDelay(1000), maxDelay(30000) {}
+    // Exponential backoff with jitter, so that clients don't retry in lockstep
+    int delay(int retry) const;
+
+    int maxRetries;
+    int baseDelay;
+    // Retry-After values longer than this are not waited for
+    int maxDelay;
 };
 
 class Http {
@@ -28,8 +49,17 @@ public:
     void setReadTimeout(int timeout);
     int getReadTimeout() { return readTimeout; }
 
+    void setRetryPolicy(const RetryPolicy &value) { retryPolicy = value; }
+    const RetryPolicy &getRetryPolicy() const { return retryPolicy; }
+
     QNetworkReply *networkReply(const HttpRequest &req);
     virtual QObject *request(const HttpRequest &req);
+    // Changes the priority of a request that has not started yet, if supported
+    virtual bool setPriority(const QUrl &url, HttpRequest::Priority priority) {
+        Q_UNUSED(url);
+        Q_UNUSED(priority);
+        return false;
+    }
     QObject *request(const QUrl &url,
             QNetworkAccessManager::Operation operation = QNetworkAccessManager::GetOperation,
             const QByteArray &body = QByteArray(),
@@ -42,6 +72,7 @@ public:
 private:
     QMap<QByteArray, QByteArray> requestHeaders;
     int readTimeout;
+    RetryPolicy retryPolicy;
 };
 
 class HttpReply : public QObject {
@@ -63,8 +94,13 @@ public:
 
     virtual QByteArray body() const = 0;
 
+public slots:
+    // Stops the request: no more signals are emitted and the reply deletes itself
+    virtual void abort();
+
 signals:
     void data(const QByteArray &bytes);
+    void chunk(const QByteArray &bytes);
     void error(const QString &message);
     void finished(const HttpReply &reply);
 };
@@ -81,14 +117,22 @@ public:
     QByteArray header(const QByteArray &headerName) const;
     QByteArray body() const;
 
+public slots:
+    void abort();
+
 private slots:
     void replyFinished();
+    void replyReadyRead();
     void replyError(QNetworkReply::NetworkError);
     void downloadProgress(qint64 bytesReceived, qint64 bytesTotal);
     void readTimeout();
+    void retry();
 
 private:
     void setupReply();
+    void scheduleRetry(int delay);
+    qint64 retryAfter() const;
+    QByteArray errorReason();
     QString errorMessage();
     void emitError();
     void emitFinished();
@@ -99,6 +143,30 @@ private:
     QTimer *readTimeoutTimer;
     int retryCount;
     QByteArray bytes;
+    // Since the request was first sent
+    QElapsedTimer timer;
+    bool firstByteReceived;
+};
+
+// Fails without hitting the network, e.g. when the circuit breaker is open
+// or when a failure is cached
+class FailedHttpReply : public HttpReply {
+    Q_OBJECT
+
+public:
+    FailedHttpReply(const QUrl &url, const QString &reasonPhrase, int statusCode = 0);
+    QUrl url() const { return requestUrl; }
+    int statusCode() const { return status; }
+    QString reasonPhrase() const { return reason; }
+    QByteArray body() const { return QByteArray(); }
+
+private slots:
+    void emitSignals();
+
+private:
+    const QUrl requestUrl;
+    const QString reason;
+    const int status;
 };
 
 #endif // HTTP_H
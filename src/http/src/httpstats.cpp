@@ -0,0 +1,152 @@
+#include "httpstats.h"
+
+namespace {
+
+QString hostClassifier(const QUrl &url) {
+    return url.host();
+}
+}
+
+HttpStats::Histogram::Histogram() : count(0), sum(0), max(0) {
+    memset(buckets, 0, sizeof(buckets));
+}
+
+void HttpStats::Histogram::add(qint64 milliseconds) {
+    // bucket 0 holds less than 1ms, bucket n from 2^(n-1) to 2^n ms
+    int bucket = 0;
+    while (bucket < bucketCount - 1 && milliseconds >= (qint64(1) << bucket))
+        ++bucket;
+    buckets[bucket]++;
+    count++;
+    sum += milliseconds;
+    if (milliseconds > max) max = milliseconds;
+}
+
+qint64 HttpStats::Histogram::percentile(int percent) const {
+    if (count == 0) return 0;
+    const int rank = qMax(1, (count * percent + 99) / 100);
+    int seen = 0;
+    for (int bucket = 0; bucket < bucketCount; ++bucket) {
+        seen += buckets[bucket];
+        if (seen >= rank) return qMin(max, qint64(1) << bucket);
+    }
+    return max;
+}
+
+QString HttpStats::Histogram::toString() const {
+    QString s = QString("n=%1 mean=%2 p50=%3 p90=%4 p99=%5 max=%6")
+                        .arg(count)
+                        .arg(mean())
+                        .arg(percentile(50))
+                        .arg(percentile(90))
+                        .arg(percentile(99))
+                        .arg(max);
+    s += QLatin1String(" |");
+    for (int bucket = 0; bucket < bucketCount; ++bucket) {
+        if (buckets[bucket] == 0) continue;
+        s += QString(" <%1ms:%2").arg(qint64(1) << bucket).arg(buckets[bucket]);
+    }
+    return s;
+}
+
+HttpStats &HttpStats::instance() {
+    static HttpStats *i = new HttpStats();
+    return *i;
+}
+
+const char *HttpStats::metricName(Metric metric) {
+    switch (metric) {
+    case QueueTime:
+        return "queue";
+    case TimeToFirstByte:
+        return "ttfb";
+    case TotalTime:
+        return "total";
+    default:
+        return "";
+    }
+}
+
+HttpStats::HttpStats() : classifier(hostClassifier) {}
+
+void HttpStats::setClassifier(Classifier value) {
+    QMutexLocker locker(&mutex);
+    classifier = value ? value : hostClassifier;
+}
+
+HttpStats::Endpoint &HttpStats::findEndpoint(const QUrl &url) {
+    return endpoints[classifier(url)];
+}
+
+void HttpStats::addTime(const QUrl &url, Metric metric, qint64 milliseconds) {
+    QMutexLocker locker(&mutex);
+    findEndpoint(url).histograms[metric].add(milliseconds);
+}
+
+void HttpStats::addRequest(const QUrl &url, qint64 bytes, int retries, bool success) {
+    QMutexLocker locker(&mutex);
+    Endpoint &endpoint = findEndpoint(url);
+    endpoint.requests++;
+    if (!success) endpoint.errors++;
+    endpoint.retries += retries;
+    endpoint.bytes += bytes;
+}
+
+void HttpStats::addCacheResult(const QUrl &url, bool hit) {
+    QMutexLocker locker(&mutex);
+    Endpoint &endpoint = findEndpoint(url);
+    if (hit)
+        endpoint.cacheHits++;
+    else
+        endpoint.cacheMisses++;
+}
+
+QStringList HttpStats::endpointNames() {
+    QMutexLocker locker(&mutex);
+    return endpoints.keys();
+}
+
+HttpStats::Endpoint HttpStats::endpoint(const QString &name) {
+    QMutexLocker locker(&mutex);
+    return endpoints.value(name);
+}
+
+QString HttpStats::report() {
+    QMutexLocker locker(&mutex);
+    QString s;
+    for (auto i = endpoints.constBegin(); i != endpoints.constEnd(); ++i) {
+        const Endpoint &endpoint = i.value();
+        s += QString("%1: requests=%2 errors=%3 retries=%4 bytes=%5 cache hits=%6 misses=%7\n")
+                     .arg(i.key())
+                     .arg(endpoint.requests)
+                     .arg(endpoint.errors)
+                     .arg(endpoint.retries)
+                     .arg(endpoint.bytes)
+                     .arg(endpoint.cacheHits)
+                     .arg(endpoint.cacheMisses);
+        for (int metric = 0; metric < MetricCount; ++metric) {
+            const Histogram &histogram = endpoint.histograms[metric];
+            if (histogram.getCount() == 0) continue;
+            s += QString("  %1 %2\n")
+                         .arg(QString::fromLatin1(metricName(Metric(metric))), -5)
+                         .arg(histogram.toString());
+        }
+    }
+    return s;
+}
+
+bool HttpStats::dump(const QString &fileName) {
+    const QString text = report();
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        qWarning() << "Cannot write" << fileName << file.errorString();
+        return false;
+    }
+    file.write(text.toUtf8());
+    return file.commit();
+}
+
+void HttpStats::clear() {
+    QMutexLocker locker(&mutex);
+    endpoints.clear();
+}
@@ -0,0 +1,81 @@
+#ifndef HTTPSTATS_H
+#define HTTPSTATS_H
+
+#include <QtCore>
+
+/**
+ * @brief Collects request timings, sizes, retries and cache results.
+ * Requests are grouped into endpoints by a classifier, each endpoint has a histogram per metric.
+ * Thread-safe.
+ */
+class HttpStats {
+public:
+    enum Metric {
+        // Time spent waiting in the ScheduledHttp queue
+        QueueTime,
+        // From sending the request to the first byte of the body, across redirects and retries
+        TimeToFirstByte,
+        TotalTime,
+        MetricCount
+    };
+
+    // Millisecond histogram with power of two buckets
+    class Histogram {
+    public:
+        Histogram();
+        void add(qint64 milliseconds);
+        int getCount() const { return count; }
+        qint64 getMax() const { return max; }
+        qint64 mean() const { return count > 0 ? sum / count : 0; }
+        // Upper bound of the bucket holding the given percentile
+        qint64 percentile(int percent) const;
+        QString toString() const;
+
+        static const int bucketCount = 20;
+
+    private:
+        int buckets[bucketCount];
+        int count;
+        qint64 sum;
+        qint64 max;
+    };
+
+    struct Endpoint {
+        Endpoint() : requests(0), errors(0), retries(0), bytes(0), cacheHits(0), cacheMisses(0) {}
+        Histogram histograms[MetricCount];
+        int requests;
+        int errors;
+        int retries;
+        qint64 bytes;
+        int cacheHits;
+        int cacheMisses;
+    };
+
+    // Names the endpoint of a request, by default its host
+    typedef QString (*Classifier)(const QUrl &url);
+
+    static HttpStats &instance();
+    static const char *metricName(Metric metric);
+
+    void setClassifier(Classifier value);
+
+    void addTime(const QUrl &url, Metric metric, qint64 milliseconds);
+    void addRequest(const QUrl &url, qint64 bytes, int retries, bool success);
+    void addCacheResult(const QUrl &url, bool hit);
+
+    QStringList endpointNames();
+    Endpoint endpoint(const QString &name);
+    QString report();
+    bool dump(const QString &fileName);
+    void clear();
+
+private:
+    HttpStats();
+    Endpoint &findEndpoint(const QUrl &url);
+
+    QMutex mutex;
+    Classifier classifier;
+    QMap<QString, Endpoint> endpoints;
+};
+
+#endif // HTTPSTATS_H
@@ -1,4 +1,18 @@
 #include "localcache.h"
+#include "localcachecodec.h"
+#include "localcachestorage.h"
+#include "localcachewriter.h"
+#include "segmentcachestorage.h"
+
+namespace {
+
+enum IndexRecordType { IndexInsert = 1, IndexRemove };
+const quint32 indexMagic = 0x4c434958; // LCIX
+const quint32 indexVersion = 5;
+const char *indexFileName = "index";
+// Access times are journaled at most this often per entry, eviction doesn't need more precision
+const uint accessJournalSeconds = 600;
+}
 
 LocalCache *LocalCache::instance(const char *name) {
     static QMap<QByteArray, LocalCache *> instances;
@@ -10,26 +24,95 @@ LocalCache *LocalCache::instance(const char *name) {
 }
 
 LocalCache::LocalCache(const QByteArray &name)
-    : name(name), maxSeconds(86400 * 30), maxSize(1024 * 1024 * 100), size(0), expiring(false),
-      insertCount(0) {
-    directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QLatin1Char('/') +
-                QLatin1String(name) + QLatin1Char('/');
+    : name(name), storageType(SegmentStorage), storage(0), writer(0),
+      maxSeconds(86400 * 30), maxSize(1024 * 1024 * 100), size(0), insertCount(0),
+      indexRecords(0), indexFlushScheduled(false), memory(1024 * 1024 * 8), hits(0), memoryHits(0),
+      misses(0) {
 #ifndef QT_NO_DEBUG_OUTPUT
-    hits = 0;
-    misses = 0;
+    decodedBytes = 0;
+    decodeTime = 0;
 #endif
+    directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QLatin1Char('/') +
+                QLatin1String(name) + QLatin1Char('/');
+    indexFile.setFileName(directory + QLatin1String(indexFileName));
 }
 
 LocalCache::~LocalCache() {
 #ifndef QT_NO_DEBUG_OUTPUT
     debugStats();
 #endif
+    shutdownStorage();
+}
+
+void LocalCache::setStorageType(StorageType value) {
+    if (storageType == value) return;
+    storageType = value;
+    if (!storage) return;
+
+    // switch storage on next access
+    shutdownStorage();
+    index.clear();
+    accessOrder.clear();
+    memory.clear();
+    indexFile.close();
+    indexRecords = 0;
+    size = 0;
+}
+
+void LocalCache::init() {
+    if (storage) return;
+    loadIndex();
+    writer = new LocalCacheWriter(storage);
+}
+
+void LocalCache::shutdownStorage() {
+    // the writer completes pending writes before stopping
+    delete writer;
+    writer = 0;
+    delete storage;
+    storage = 0;
+}
+
+LocalCacheStorage *LocalCache::createStorage() const {
+    if (storageType == FileStorage) return new FileCacheStorage(directory);
+    return new SegmentCacheStorage(directory + QLatin1String("segments/"));
+}
+
+quint64 LocalCache::hash64(const QByteArray &s) {
+    // MurmurHash64A, much cheaper than a cryptographic hash for short keys like URLs.
+    // Collisions are harmless since entries store their full key.
+    const quint64 m = Q_UINT64_C(0xc6a4a7935bd1e995);
+    const int r = 47;
+    const int length = s.size();
+    const uchar *data = reinterpret_cast<const uchar *>(s.constData());
+    const uchar *end = data + (length & ~7);
+    quint64 h = quint64(length) * m;
+
+    for (; data != end; data += 8) {
+        quint64 k = qFromLittleEndian<quint64>(data);
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+
+    const int tail = length & 7;
+    if (tail > 0) {
+        for (int i = 0; i < tail; ++i)
+            h ^= quint64(data[i]) << (8 * i);
+        h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
 }
 
 QByteArray LocalCache::hash(const QByteArray &s) {
-    QCryptographicHash hash(QCryptographicHash::Sha1);
-    hash.addData(s);
-    const QByteArray h = QByteArray::number(*(qlonglong *)hash.result().constData(), 36);
+    // fixed width, 13 digits fit any 64 bit value
+    const QByteArray h = QByteArray::number(hash64(s), 36).rightJustified(13, '0');
     static const char sep('/');
     QByteArray p;
     p.reserve(h.length() + 2);
@@ -37,124 +120,368 @@ QByteArray LocalCache::hash(const QByteArray &s) {
     p.append(sep);
     p.append(h.at(1));
     p.append(sep);
-    p.append(h.constData() + 2, strlen(h.constData()) - 2); // p.append(h.mid(2));
+    p.append(h.constData() + 2, h.length() - 2);
     return p;
 }
 
-bool LocalCache::isCached(const QString &path) {
-    bool cached = (QFile::exists(path) &&
-                   (maxSeconds == 0 ||
-                    QDateTime::currentDateTime().toTime_t() - QFileInfo(path).created().toTime_t() <
-                            maxSeconds));
-#ifndef QT_NO_DEBUG_OUTPUT
-    if (!cached) misses++;
-#endif
-    return cached;
+bool LocalCache::isExpired(uint created) const {
+    return maxSeconds > 0 && QDateTime::currentDateTime().toTime_t() - created >= maxSeconds;
+}
+
+void LocalCache::addToMemory(const QByteArray &id,
+                             const QByteArray &key,
+                             const QByteArray &value,
+                             uint created) {
+    MemoryItem *item = new MemoryItem;
+    item->key = key;
+    item->value = value;
+    item->created = created;
+    // QCache takes ownership and deletes items larger than the whole budget
+    memory.insert(id, item, key.size() + value.size());
+}
+
+const LocalCache::MemoryItem *LocalCache::memoryItem(const QByteArray &id,
+                                                     const QByteArray &key) {
+    const MemoryItem *item = memory.object(id);
+    if (item && item->key != key) return 0;
+    return item;
 }
 
 QByteArray LocalCache::value(const QByteArray &key) {
-    const QString path = cachePath(key);
-    if (!isCached(path)) return QByteArray();
+    init();
+    const QByteArray id = hash(key);
 
-    QFile file(path);
-    if (!file.open(QIODevice::ReadOnly)) {
-        qWarning() << __PRETTY_FUNCTION__ << file.fileName() << file.errorString();
-#ifndef QT_NO_DEBUG_OUTPUT
+    const MemoryItem *item = memoryItem(id, key);
+    if (item) {
+        if (!isExpired(item->created)) {
+            hits++;
+            memoryHits++;
+            touch(id);
+            return item->value;
+        }
+        memory.remove(id);
+    }
+
+    auto i = index.constFind(id);
+    if (i == index.constEnd() || isExpired(i->created)) {
+        misses++;
+        return QByteArray();
+    }
+    const uint created = i->created;
+
+    const QByteArray value = read(id, key);
+    if (value.isNull()) {
         misses++;
-#endif
         return QByteArray();
     }
-#ifndef QT_NO_DEBUG_OUTPUT
     hits++;
+    addToMemory(id, key, value, created);
+    touch(id);
+    return value;
+}
+
+bool LocalCache::contains(const QByteArray &key) {
+    init();
+    auto i = index.constFind(hash(key));
+    return i != index.constEnd() && !isExpired(i->created);
+}
+
+QByteArray LocalCache::staleValue(const QByteArray &key, uint *age, Validators *validators) {
+    init();
+    const QByteArray id = hash(key);
+    auto i = index.constFind(id);
+    if (i == index.constEnd()) return QByteArray();
+    const uint created = i->created;
+    const Validators entryValidators = i->validators;
+
+    // expired entries are dropped from the memory tier, don't bring them back
+    const MemoryItem *item = memoryItem(id, key);
+    const QByteArray value = item ? item->value : read(id, key);
+    if (value.isNull()) return value;
+    *age = QDateTime::currentDateTime().toTime_t() - created;
+    *validators = entryValidators;
+    touch(id);
+    return value;
+}
+
+QByteArray LocalCache::read(const QByteArray &id, const QByteArray &key) {
+    // the value may still be on its way to the storage
+    QByteArray value;
+    if (!writer->pending(id, key, &value)) {
+#ifndef QT_NO_DEBUG_OUTPUT
+        QElapsedTimer timer;
+        timer.start();
+#endif
+        const QByteArray entry = storage->read(id);
+        if (!entry.isNull()) value = LocalCacheCodec::decode(entry, key);
+#ifndef QT_NO_DEBUG_OUTPUT
+        decodeTime += timer.nsecsElapsed();
+        decodedBytes += entry.size();
 #endif
-    return file.readAll();
+    }
+    if (value.isNull()) {
+        // the index is out of sync with the storage or the entry belongs to a colliding key
+        remove(id);
+    }
+    return value;
+}
+
+void LocalCache::insert(const QByteArray &key,
+                        const QByteArray &value,
+                        const Validators &validators) {
+    init();
+    applyStoredSizes();
+    const QByteArray id = hash(key);
+    const uint now = QDateTime::currentDateTime().toTime_t();
+    addToMemory(id, key, value, now);
+
+    auto i = index.find(id);
+    if (i != index.end()) {
+        size -= i->size;
+        accessOrder.remove(i->accessed, id);
+    } else {
+        i = index.insert(id, IndexEntry());
+    }
+    // until the writer reports the encoded size
+    i->size = value.size();
+    i->created = now;
+    i->accessed = now;
+    i->validators = validators;
+    accessOrder.insert(now, id);
+    size += i->size;
+    appendToIndex(id);
+    writer->write(id, key, value);
+    ++insertCount;
+
+    if (maxSize > 0 && size > maxSize) expire();
+    scheduleIndexFlush();
+}
+
+void LocalCache::refresh(const QByteArray &key) {
+    init();
+    const QByteArray id = hash(key);
+    auto i = index.find(id);
+    if (i == index.end()) return;
+    i->created = QDateTime::currentDateTime().toTime_t();
+    MemoryItem *item = memory.object(id);
+    if (item && item->key == key) item->created = i->created;
+    touch(id);
+    appendToIndex(id);
+    scheduleIndexFlush();
+}
+
+void LocalCache::applyStoredSizes() {
+    const QHash<QByteArray, qint64> sizes = writer->takeStoredSizes();
+    for (auto s = sizes.constBegin(); s != sizes.constEnd(); ++s) {
+        auto i = index.find(s.key());
+        if (i == index.end() || i->size == s.value()) continue;
+        size += s.value() - i->size;
+        i->size = s.value();
+        appendToIndex(s.key());
+    }
 }
 
-void LocalCache::insert(const QByteArray &key, const QByteArray &value) {
-    const QueueItem item = {key, value};
-    insertQueue.append(item);
+void LocalCache::scheduleIndexFlush() {
+    // batch journal flushes of insert bursts
+    if (indexFlushScheduled) return;
+    indexFlushScheduled = true;
     QTimer::singleShot(0, [this]() {
-        if (insertQueue.isEmpty()) return;
-        for (const auto &item : insertQueue) {
-            const QString path = cachePath(item.key);
-            const QString parentDir = path.left(path.lastIndexOf('/'));
-            if (!QFile::exists(parentDir)) {
-                QDir().mkpath(parentDir);
-            }
-            QFile file(path);
-            if (!file.open(QIODevice::WriteOnly)) {
-                qWarning() << "Cannot create" << path;
-                continue;
-            }
-            file.write(item.value);
-            file.close();
-            if (size > 0) size += item.value.size();
-        }
-        insertQueue.clear();
+        indexFlushScheduled = false;
+        if (writer) applyStoredSizes();
+        if (indexFile.isOpen()) indexFile.flush();
 
-        // expire cache every n inserts
-        if (maxSize > 0 && ++insertCount % 100 == 0) {
-            if (size == 0 || size > maxSize) size = expire();
-        }
+        // compact the journal once it's mostly made of stale records
+        if (indexRecords > index.size() * 2 + 1000) saveIndex();
     });
 }
 
 bool LocalCache::clear() {
-#ifndef QT_NO_DEBUG_OUTPUT
+    init();
+    writer->discard();
+    memory.clear();
+    index.clear();
+    accessOrder.clear();
+    indexFile.close();
+    indexRecords = 0;
     hits = 0;
+    memoryHits = 0;
     misses = 0;
-#endif
     size = 0;
     insertCount = 0;
-    return QDir(directory).removeRecursively();
+    const bool success = storage->clear();
+    QFile::remove(indexFile.fileName());
+    return success;
 }
 
-QString LocalCache::cachePath(const QByteArray &key) const {
-    return directory + QLatin1String(key.constData());
+void LocalCache::flush() {
+    if (!storage) return;
+    writer->flush();
+    applyStoredSizes();
+    // access times that touch() didn't journal yet
+    QVector<QByteArray> touched;
+    for (auto i = index.constBegin(); i != index.constEnd(); ++i)
+        if (i->accessed != i->journaledAccess) touched << i.key();
+    for (const QByteArray &key : touched)
+        appendToIndex(key);
+    if (indexFile.isOpen()) indexFile.flush();
 }
 
-qint64 LocalCache::expire() {
-    if (expiring) return size;
-    expiring = true;
-
-    QDir::Filters filters = QDir::AllDirs | QDir::Files | QDir::NoDotAndDotDot;
-    QDirIterator it(directory, filters, QDirIterator::Subdirectories);
+void LocalCache::touch(const QByteArray &key) {
+    auto i = index.find(key);
+    if (i == index.end()) return;
+    const uint now = QDateTime::currentDateTime().toTime_t();
+    if (i->accessed == now) return;
+    accessOrder.remove(i->accessed, key);
+    i->accessed = now;
+    accessOrder.insert(now, key);
 
-    QMultiMap<QDateTime, QString> cacheItems;
-    qint64 totalSize = 0;
-    while (it.hasNext()) {
-        QString path = it.next();
-        QFileInfo info = it.fileInfo();
-        cacheItems.insert(info.created(), path);
-        totalSize += info.size();
-        qApp->processEvents();
+    // so that eviction order survives restarts
+    if (now - i->journaledAccess >= accessJournalSeconds) {
+        appendToIndex(key);
+        scheduleIndexFlush();
     }
+}
 
+void LocalCache::remove(const QByteArray &key) {
+    auto i = index.find(key);
+    if (i == index.end()) return;
+    size -= i->size;
+    accessOrder.remove(i->accessed, key);
+    index.erase(i);
+    memory.remove(key);
+    writer->remove(key);
+    appendRemovalToIndex(key);
+}
+
+void LocalCache::expire() {
+    const qint64 goal = (maxSize * 9) / 10;
     int removedFiles = 0;
-    qint64 goal = (maxSize * 9) / 10;
-    auto i = cacheItems.constBegin();
-    while (i != cacheItems.constEnd()) {
-        if (totalSize < goal) break;
-        QString name = i.value();
-        QFile file(name);
-        qint64 size = file.size();
-        file.remove();
-        totalSize -= size;
+    while (size > goal && !accessOrder.isEmpty()) {
+        const QByteArray key = accessOrder.first();
+        remove(key);
         ++removedFiles;
-        ++i;
-        qApp->processEvents();
     }
+    if (indexFile.isOpen()) indexFile.flush();
 #ifndef QT_NO_DEBUG_OUTPUT
     debugStats();
     if (removedFiles > 0) {
-        qDebug() << "Removed:" << removedFiles << "Kept:" << cacheItems.count() - removedFiles
-                 << "New Size:" << totalSize;
+        qDebug() << "Removed:" << removedFiles << "Kept:" << index.size() << "New Size:" << size;
     }
 #endif
+}
+
+void LocalCache::loadIndex() {
+    bool valid = false;
+    QDataStream in(&indexFile);
+    in.setVersion(QDataStream::Qt_5_0);
+    if (indexFile.open(QIODevice::ReadOnly)) {
+        quint32 magic, version;
+        quint8 type;
+        in >> magic >> version >> type;
+        valid = in.status() == QDataStream::Ok && magic == indexMagic && version == indexVersion &&
+                type == storageType;
+        if (!valid) qWarning() << "Discarding cache" << directory;
+    }
+    if (!valid) {
+        // Either the cache predates the index or it was written with another storage type.
+        // Older entries are stored under a different hash of their key and don't contain the
+        // key itself, so there's no way to migrate them.
+        indexFile.close();
+        QDir(directory).removeRecursively();
+        storage = createStorage();
+        return;
+    }
 
-    expiring = false;
+    storage = createStorage();
+    while (!in.atEnd()) {
+        quint8 type;
+        QByteArray key;
+        in >> type >> key;
+        if (type == IndexInsert) {
+            IndexEntry entry;
+            in >> entry.size >> entry.created >> entry.accessed >> entry.validators.etag >>
+                    entry.validators.lastModified;
+            if (in.status() != QDataStream::Ok) break;
+            entry.journaledAccess = entry.accessed;
+            auto i = index.constFind(key);
+            if (i != index.constEnd()) {
+                size -= i->size;
+                accessOrder.remove(i->accessed, key);
+            }
+            index.insert(key, entry);
+            accessOrder.insert(entry.accessed, key);
+            size += entry.size;
+        } else if (type == IndexRemove) {
+            if (in.status() != QDataStream::Ok) break;
+            auto i = index.find(key);
+            if (i != index.end()) {
+                size -= i->size;
+                accessOrder.remove(i->accessed, key);
+                index.erase(i);
+            }
+        } else {
+            break;
+        }
+        ++indexRecords;
+    }
+    const bool truncated = in.status() != QDataStream::Ok || !in.atEnd();
+    indexFile.close();
+
+    // a crash can leave a partial record at the end of the journal
+    if (truncated) saveIndex();
+}
+
+void LocalCache::saveIndex() {
+    indexFile.close();
+    QDir().mkpath(directory);
+
+    QSaveFile file(indexFile.fileName());
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot write" << file.fileName() << file.errorString();
+        return;
+    }
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << indexMagic << indexVersion << quint8(storageType);
+    for (auto i = index.begin(); i != index.end(); ++i) {
+        out << quint8(IndexInsert) << i.key() << i->size << i->created << i->accessed
+            << i->validators.etag << i->validators.lastModified;
+        i->journaledAccess = i->accessed;
+    }
+    if (!file.commit()) qWarning() << "Cannot commit" << file.fileName() << file.errorString();
+    indexRecords = index.size();
+}
+
+bool LocalCache::openIndexJournal() {
+    if (indexFile.isOpen()) return true;
+    if (!indexFile.exists()) {
+        // start from a snapshot so that the header is in place
+        saveIndex();
+    }
+    if (!indexFile.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "Cannot open" << indexFile.fileName() << indexFile.errorString();
+        return false;
+    }
+    return true;
+}
+
+void LocalCache::appendToIndex(const QByteArray &key) {
+    if (!openIndexJournal()) return;
+    IndexEntry &entry = index[key];
+    QDataStream out(&indexFile);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << quint8(IndexInsert) << key << entry.size << entry.created << entry.accessed
+        << entry.validators.etag << entry.validators.lastModified;
+    entry.journaledAccess = entry.accessed;
+    ++indexRecords;
+}
 
-    return totalSize;
+void LocalCache::appendRemovalToIndex(const QByteArray &key) {
+    if (!openIndexJournal()) return;
+    QDataStream out(&indexFile);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << quint8(IndexRemove) << key;
+    ++indexRecords;
 }
 
 #ifndef QT_NO_DEBUG_OUTPUT
@@ -165,7 +492,11 @@ void LocalCache::debugStats() {
                  << "Inserts:" << insertCount << '\n'
                  << "Requests:" << total << '\n'
                  << "Hits:" << hits << (hits * 100) / total << "%\n"
+                 << "Memory hits:" << memoryHits << (memoryHits * 100) / total << "%\n"
                  << "Misses:" << misses << (misses * 100) / total << "%";
     }
+    if (writer) writer->debugStats();
+    if (decodedBytes > 0)
+        qDebug() << "Read:" << decodedBytes << "Decode time:" << decodeTime / 1000000 << "ms";
 }
 #endif
@@ -3,49 +3,137 @@
 
 #include <QtCore>
 
+class LocalCacheStorage;
+class LocalCacheWriter;
+
 /**
- * @brief Not thread-safe
+ * @brief Not thread-safe, storage writes are done on a background thread
+ * Entries are transparently compressed on storage unless they already are, e.g. JPEG thumbnails.
+ * Keys can be arbitrarily long, entries are stored under a fast hash of the key
+ * and keep the full key to tell collisions apart.
  */
 class LocalCache {
 public:
+    enum StorageType {
+        // Append-only segment files with an offset index
+        SegmentStorage = 1,
+        // One file per entry
+        FileStorage
+    };
+
+    // HTTP validators of a stored response, used to revalidate it when expired
+    struct Validators {
+        QByteArray etag;
+        QByteArray lastModified;
+        bool isEmpty() const { return etag.isEmpty() && lastModified.isEmpty(); }
+    };
+
     static LocalCache *instance(const char *name);
     ~LocalCache();
-    static QByteArray hash(const QByteArray &s);
 
     const QByteArray &getName() const { return name; }
 
     void setMaxSeconds(uint value) { maxSeconds = value; }
+    uint getMaxSeconds() const { return maxSeconds; }
     void setMaxSize(uint value) { maxSize = value; }
+    void setMaxMemory(uint value) { memory.setMaxCost(value); }
+    void setStorageType(StorageType value);
+
+    uint getHits() const { return hits; }
+    uint getMemoryHits() const { return memoryHits; }
+    uint getMisses() const { return misses; }
 
     QByteArray value(const QByteArray &key);
-    void insert(const QByteArray &key, const QByteArray &value);
+    // True if a fresh entry is in the index. Does not count as a hit or miss.
+    bool contains(const QByteArray &key);
+    // Returns the value even if expired, along with its age. Does not count as a hit or miss.
+    QByteArray staleValue(const QByteArray &key, uint *age, Validators *validators);
+    void insert(const QByteArray &key,
+                const QByteArray &value,
+                const Validators &validators = Validators());
+    // Makes an expired entry fresh again, e.g. after a 304 Not Modified
+    void refresh(const QByteArray &key);
     bool clear();
+    // Blocks until all pending writes are on disk, call it before quitting
+    void flush();
 
 private:
+    // Times hash64() against SHA1, see benchmarks/cachekeys
+    friend class CacheKeyBenchmark;
+
     LocalCache(const QByteArray &name);
-    QString cachePath(const QByteArray &key) const;
-    bool isCached(const QString &path);
-    qint64 expire();
+    static quint64 hash64(const QByteArray &s);
+    // Storage id of a key
+    static QByteArray hash(const QByteArray &s);
+    void init();
+    void shutdownStorage();
+    LocalCacheStorage *createStorage() const;
+    bool isExpired(uint created) const;
+    QByteArray read(const QByteArray &id, const QByteArray &key);
+    void addToMemory(const QByteArray &id,
+                     const QByteArray &key,
+                     const QByteArray &value,
+                     uint created);
+    void touch(const QByteArray &key);
+    void remove(const QByteArray &key);
+    void expire();
+
+    void loadIndex();
+    void saveIndex();
+    void appendToIndex(const QByteArray &key);
+    void appendRemovalToIndex(const QByteArray &key);
+    bool openIndexJournal();
+    void scheduleIndexFlush();
+    // Accounts for the encoded size of entries written so far
+    void applyStoredSizes();
 #ifndef QT_NO_DEBUG_OUTPUT
     void debugStats();
 #endif
 
     QByteArray name;
     QString directory;
+    StorageType storageType;
+    LocalCacheStorage *storage;
+    // Storage writes happen on this thread
+    LocalCacheWriter *writer;
     uint maxSeconds;
     qint64 maxSize;
     qint64 size;
-    bool expiring;
     uint insertCount;
-    struct QueueItem {
+
+    // Persistent index of what is on disk by id, so lookups and eviction never scan the directory.
+    // It's stored as a snapshot followed by a journal of insertions and removals.
+    struct IndexEntry {
+        // Size on storage
+        qint64 size;
+        uint created;
+        uint accessed;
+        // Access time as of the last journal record, not stored
+        uint journaledAccess;
+        Validators validators;
+    };
+    QHash<QByteArray, IndexEntry> index;
+    // Eviction order, least recently accessed first
+    QMultiMap<uint, QByteArray> accessOrder;
+    QFile indexFile;
+    int indexRecords;
+    bool indexFlushScheduled;
+
+    // Hot entries kept in process by id, cost is the key and value size in bytes
+    struct MemoryItem {
         QByteArray key;
         QByteArray value;
+        uint created;
     };
-    QVector<QueueItem> insertQueue;
+    QCache<QByteArray, MemoryItem> memory;
+    const MemoryItem *memoryItem(const QByteArray &id, const QByteArray &key);
 
-#ifndef QT_NO_DEBUG_OUTPUT
     uint hits;
+    uint memoryHits;
     uint misses;
+#ifndef QT_NO_DEBUG_OUTPUT
+    qint64 decodedBytes;
+    qint64 decodeTime;
 #endif
 };
 
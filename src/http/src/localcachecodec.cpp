@@ -0,0 +1,70 @@
+#include "localcachecodec.h"
+
+namespace {
+
+// Below this compressing is not worth the header and the CPU
+const int minCompressSize = 256;
+// Codec byte and key size
+const int headerSize = 5;
+}
+
+bool LocalCacheCodec::isCompressed(const QByteArray &value) {
+    const char *d = value.constData();
+    // JPEG, PNG, GIF and WebP images
+    return value.startsWith("\xff\xd8\xff") || value.startsWith("\x89PNG") ||
+           value.startsWith("GIF8") || (value.startsWith("RIFF") && value.size() > 12 &&
+                                        qstrncmp(d + 8, "WEBP", 4) == 0);
+}
+
+QByteArray LocalCacheCodec::header(Codec codec, const QByteArray &key, int payloadSize) {
+    QByteArray entry;
+    entry.reserve(headerSize + key.size() + payloadSize);
+    entry.append(char(codec));
+    uchar keySize[4];
+    qToBigEndian(quint32(key.size()), keySize);
+    entry.append(reinterpret_cast<const char *>(keySize), sizeof(keySize));
+    entry.append(key);
+    return entry;
+}
+
+QByteArray LocalCacheCodec::encode(const QByteArray &key, const QByteArray &value) {
+    if (value.size() >= minCompressSize && !isCompressed(value)) {
+        const QByteArray compressed = qCompress(value);
+        // keep it raw unless it saves at least 10%
+        if (compressed.size() < value.size() - value.size() / 10) {
+            QByteArray entry = header(Zlib, key, compressed.size());
+            entry.append(compressed);
+            return entry;
+        }
+    }
+    QByteArray entry = header(Raw, key, value.size());
+    entry.append(value);
+    return entry;
+}
+
+QByteArray LocalCacheCodec::decode(const QByteArray &entry, const QByteArray &key) {
+    if (entry.size() < headerSize) return QByteArray();
+    const uchar *data = reinterpret_cast<const uchar *>(entry.constData());
+    const char codec = entry.at(0);
+    const quint32 keySize = qFromBigEndian<quint32>(data + 1);
+    if (keySize > quint32(entry.size() - headerSize)) {
+        qWarning() << "Invalid cache entry";
+        return QByteArray();
+    }
+
+    // compare the key before paying for decompression
+    const int payload = headerSize + keySize;
+    if (int(keySize) != key.size() || memcmp(data + headerSize, key.constData(), keySize) != 0) {
+        qDebug() << "Cache key collision" << key;
+        return QByteArray();
+    }
+
+    if (codec == Raw) return entry.mid(payload);
+    if (codec == Zlib) {
+        const QByteArray value = qUncompress(data + payload, entry.size() - payload);
+        // an empty value never gets compressed
+        if (!value.isEmpty()) return value;
+    }
+    qWarning() << "Invalid cache entry, codec" << int(codec);
+    return QByteArray();
+}
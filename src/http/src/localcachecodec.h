@@ -0,0 +1,27 @@
+#ifndef LOCALCACHECODEC_H
+#define LOCALCACHECODEC_H
+
+#include <QtCore>
+
+/**
+ * @brief Encodes LocalCache entries for storage.
+ * Entries start with a byte recording the codec and the full key of the entry,
+ * so that a hash collision between storage ids is detected instead of returning the wrong value.
+ * Text like JSON is compressed while content that is already compressed, like images,
+ * is stored as is.
+ */
+class LocalCacheCodec {
+public:
+    enum Codec { Raw, Zlib };
+
+    static QByteArray encode(const QByteArray &key, const QByteArray &value);
+    // Returns a null QByteArray if the entry is corrupted or belongs to another key
+    static QByteArray decode(const QByteArray &entry, const QByteArray &key);
+
+private:
+    LocalCacheCodec() {}
+    static bool isCompressed(const QByteArray &value);
+    static QByteArray header(Codec codec, const QByteArray &key, int payloadSize);
+};
+
+#endif // LOCALCACHECODEC_H
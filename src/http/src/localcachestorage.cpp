@@ -0,0 +1,48 @@
+#include "localcachestorage.h"
+
+FileCacheStorage::FileCacheStorage(const QString &directory) : directory(directory) {}
+
+QString FileCacheStorage::path(const QByteArray &key) const {
+    return directory + QLatin1String(key.constData());
+}
+
+QByteArray FileCacheStorage::read(const QByteArray &key) {
+    QFile file(path(key));
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << __PRETTY_FUNCTION__ << file.fileName() << file.errorString();
+        return QByteArray();
+    }
+    return file.readAll();
+}
+
+bool FileCacheStorage::write(const QByteArray &key, const QByteArray &value) {
+    const QString path = this->path(key);
+    const QString parentDir = path.left(path.lastIndexOf('/'));
+    if (!QFile::exists(parentDir)) {
+        QDir().mkpath(parentDir);
+    }
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot create" << path;
+        return false;
+    }
+    file.write(value);
+    file.close();
+    return true;
+}
+
+void FileCacheStorage::remove(const QByteArray &key) {
+    QFile::remove(path(key));
+}
+
+bool FileCacheStorage::clear() {
+    QDir dir(directory);
+    const auto entries = dir.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot);
+    bool success = true;
+    for (const QFileInfo &info : entries) {
+        // the fan-out directories are named after a single character of the hash
+        if (info.fileName().length() != 1) continue;
+        if (!QDir(info.filePath()).removeRecursively()) success = false;
+    }
+    return success;
+}
@@ -0,0 +1,37 @@
+#ifndef LOCALCACHESTORAGE_H
+#define LOCALCACHESTORAGE_H
+
+#include <QtCore>
+
+/**
+ * @brief Where LocalCache keeps its values on disk.
+ * Implementations can be called from more than one thread.
+ */
+class LocalCacheStorage {
+public:
+    virtual ~LocalCacheStorage() {}
+    virtual QByteArray read(const QByteArray &key) = 0;
+    virtual bool write(const QByteArray &key, const QByteArray &value) = 0;
+    virtual void remove(const QByteArray &key) = 0;
+    virtual bool clear() = 0;
+    virtual void flush() {}
+};
+
+/**
+ * @brief One file per key, keys are relative paths
+ */
+class FileCacheStorage : public LocalCacheStorage {
+public:
+    FileCacheStorage(const QString &directory);
+    QByteArray read(const QByteArray &key);
+    bool write(const QByteArray &key, const QByteArray &value);
+    void remove(const QByteArray &key);
+    bool clear();
+
+private:
+    QString path(const QByteArray &key) const;
+
+    QString directory;
+};
+
+#endif // LOCALCACHESTORAGE_H
@@ -0,0 +1,150 @@
+#include "localcachewriter.h"
+#include "localcachecodec.h"
+#include "localcachestorage.h"
+
+LocalCacheWriter::LocalCacheWriter(LocalCacheStorage *storage)
+    : storage(storage), maxQueueSize(256), maxQueueBytes(1024 * 1024 * 16), queueBytes(0),
+      sequence(0), busy(false), stopping(false) {
+#ifndef QT_NO_DEBUG_OUTPUT
+    encodedBytes = 0;
+    storedBytes = 0;
+    encodeTime = 0;
+#endif
+    start(QThread::LowPriority);
+}
+
+LocalCacheWriter::~LocalCacheWriter() {
+    stop();
+}
+
+void LocalCacheWriter::write(const QByteArray &id, const QByteArray &key, const QByteArray &value) {
+    const Operation operation = {id, key, value, false, 0};
+    enqueue(operation);
+}
+
+void LocalCacheWriter::remove(const QByteArray &id) {
+    const Operation operation = {id, QByteArray(), QByteArray(), true, 0};
+    enqueue(operation);
+}
+
+void LocalCacheWriter::enqueue(const Operation &operation) {
+    QMutexLocker locker(&mutex);
+    // Backpressure: the GUI thread waits rather than queuing unbounded data
+    while (!queue.isEmpty() &&
+           (queue.size() >= maxQueueSize || queueBytes + operation.value.size() > maxQueueBytes))
+        queueNotFull.wait(&mutex);
+
+    Operation item = operation;
+    item.sequence = ++sequence;
+    queue.enqueue(item);
+    latest.insert(item.id, item);
+    queueBytes += item.value.size();
+    queueNotEmpty.wakeOne();
+}
+
+bool LocalCacheWriter::pending(const QByteArray &id, const QByteArray &key, QByteArray *value) {
+    QMutexLocker locker(&mutex);
+    auto i = latest.constFind(id);
+    if (i == latest.constEnd()) return false;
+    *value = i->remove || i->key != key ? QByteArray() : i->value;
+    return true;
+}
+
+QHash<QByteArray, qint64> LocalCacheWriter::takeStoredSizes() {
+    QMutexLocker locker(&mutex);
+    QHash<QByteArray, qint64> sizes;
+    sizes.swap(storedSizes);
+    return sizes;
+}
+
+void LocalCacheWriter::flush() {
+    {
+        QMutexLocker locker(&mutex);
+        while (!isIdle())
+            idle.wait(&mutex);
+    }
+    storage->flush();
+}
+
+void LocalCacheWriter::discard() {
+    QMutexLocker locker(&mutex);
+    queue.clear();
+    latest.clear();
+    storedSizes.clear();
+    queueBytes = 0;
+    queueNotFull.wakeAll();
+    while (busy)
+        idle.wait(&mutex);
+}
+
+void LocalCacheWriter::stop() {
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        queueNotEmpty.wakeAll();
+    }
+    wait();
+}
+
+void LocalCacheWriter::run() {
+    QMutexLocker locker(&mutex);
+    forever {
+        while (queue.isEmpty() && !stopping)
+            queueNotEmpty.wait(&mutex);
+        // pending writes are completed before stopping
+        if (queue.isEmpty()) break;
+
+        const Operation operation = queue.dequeue();
+        queueBytes -= operation.value.size();
+        busy = true;
+        queueNotFull.wakeAll();
+        locker.unlock();
+
+        qint64 storedSize = -1;
+#ifndef QT_NO_DEBUG_OUTPUT
+        qint64 elapsed = 0;
+#endif
+        if (operation.remove) {
+            storage->remove(operation.id);
+        } else {
+#ifndef QT_NO_DEBUG_OUTPUT
+            QElapsedTimer timer;
+            timer.start();
+#endif
+            const QByteArray entry = LocalCacheCodec::encode(operation.key, operation.value);
+#ifndef QT_NO_DEBUG_OUTPUT
+            elapsed = timer.nsecsElapsed();
+#endif
+            if (storage->write(operation.id, entry))
+                storedSize = entry.size();
+            else
+                qWarning() << "Cannot write cache entry" << operation.id;
+        }
+
+        locker.relock();
+        busy = false;
+#ifndef QT_NO_DEBUG_OUTPUT
+        if (storedSize >= 0) {
+            encodeTime += elapsed;
+            encodedBytes += operation.value.size();
+            storedBytes += storedSize;
+        }
+#endif
+        if (storedSize >= 0) storedSizes.insert(operation.id, storedSize);
+        // readers now find it in the storage
+        auto i = latest.find(operation.id);
+        if (i != latest.end() && i->sequence == operation.sequence) latest.erase(i);
+        if (queue.isEmpty()) idle.wakeAll();
+    }
+    idle.wakeAll();
+}
+
+#ifndef QT_NO_DEBUG_OUTPUT
+void LocalCacheWriter::debugStats() {
+    QMutexLocker locker(&mutex);
+    if (encodedBytes == 0) return;
+    qDebug() << "Written:" << encodedBytes << "Stored:" << storedBytes
+             << (storedBytes * 100) / encodedBytes << "%\n"
+             << "Encode time:" << encodeTime / 1000000 << "ms";
+}
+#endif
@@ -0,0 +1,76 @@
+#ifndef LOCALCACHEWRITER_H
+#define LOCALCACHEWRITER_H
+
+#include <QtCore>
+
+class LocalCacheStorage;
+
+/**
+ * @brief Performs LocalCache storage writes and removals on its own thread.
+ * Operations are on storage ids, values are encoded along with their key by LocalCacheCodec.
+ * The queue is bounded, producers block when it is full.
+ * Pending operations can be looked up so that readers see their own writes.
+ */
+class LocalCacheWriter : public QThread {
+public:
+    LocalCacheWriter(LocalCacheStorage *storage);
+    ~LocalCacheWriter();
+
+    void write(const QByteArray &id, const QByteArray &key, const QByteArray &value);
+    void remove(const QByteArray &id);
+
+    // Returns true if an operation on id is pending.
+    // value is null for a pending removal or if the pending write is for another key.
+    bool pending(const QByteArray &id, const QByteArray &key, QByteArray *value);
+
+    // Returns the size on storage of the entries written since the last call
+    QHash<QByteArray, qint64> takeStoredSizes();
+#ifndef QT_NO_DEBUG_OUTPUT
+    void debugStats();
+#endif
+
+    // Blocks until the queue is empty and the storage is flushed
+    void flush();
+    // Drops queued operations and waits for the current one
+    void discard();
+    void stop();
+
+protected:
+    void run();
+
+private:
+    struct Operation {
+        QByteArray id;
+        QByteArray key;
+        QByteArray value;
+        bool remove;
+        quint64 sequence;
+    };
+    void enqueue(const Operation &operation);
+    bool isIdle() const { return queue.isEmpty() && !busy; }
+
+    LocalCacheStorage *storage;
+    int maxQueueSize;
+    qint64 maxQueueBytes;
+
+    QMutex mutex;
+    QWaitCondition queueNotEmpty;
+    QWaitCondition queueNotFull;
+    QWaitCondition idle;
+    QQueue<Operation> queue;
+    // Latest pending operation for each id
+    QHash<QByteArray, Operation> latest;
+    qint64 queueBytes;
+    QHash<QByteArray, qint64> storedSizes;
+    quint64 sequence;
+    bool busy;
+    bool stopping;
+
+#ifndef QT_NO_DEBUG_OUTPUT
+    qint64 encodedBytes;
+    qint64 storedBytes;
+    qint64 encodeTime;
+#endif
+};
+
+#endif // LOCALCACHEWRITER_H
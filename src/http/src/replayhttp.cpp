@@ -0,0 +1,138 @@
+#include "replayhttp.h"
+
+namespace {
+
+const quint32 fixtureMagic = 0x52504c59; // RPLY
+const quint32 fixtureVersion = 1;
+// Bandwidth shaping granularity
+const int chunkInterval = 100;
+}
+
+ReplayHttp::ReplayHttp(Http &http, const QString &directory, Mode mode)
+    : http(http), directory(directory), mode(mode), latency(0), bandwidth(0) {
+    if (!this->directory.endsWith(QLatin1Char('/'))) this->directory += QLatin1Char('/');
+    if (mode == Record) QDir().mkpath(this->directory);
+    qWarning() << (mode == Record ? "Recording" : "Replaying") << "http fixtures in" << directory;
+}
+
+QString ReplayHttp::fileName(const HttpRequest &req) const {
+    // fixtures survive API key rotation
+    QUrl url = req.url;
+    QUrlQuery q(url);
+    q.removeAllQueryItems(QStringLiteral("key"));
+    url.setQuery(q);
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArray::number(req.operation));
+    hash.addData(url.toEncoded());
+    hash.addData(req.body);
+    hash.addData(QByteArray::number(req.offset));
+    return directory + QLatin1String(hash.result().toHex());
+}
+
+bool ReplayHttp::loadFixture(const QString &fileName, Fixture &fixture) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+    quint32 magic, version;
+    qint32 status;
+    in >> magic >> version;
+    if (in.status() != QDataStream::Ok || magic != fixtureMagic || version != fixtureVersion)
+        return false;
+    in >> fixture.url >> status >> fixture.reason >> fixture.headers >> fixture.body;
+    if (in.status() != QDataStream::Ok) return false;
+    fixture.status = status;
+    return true;
+}
+
+QObject *ReplayHttp::request(const HttpRequest &req) {
+    if (mode == Replay) return new ReplayHttpReply(req, fileName(req), latency, bandwidth);
+
+    QObject *reply = http.request(req);
+    HttpReply *httpReply = qobject_cast<HttpReply *>(reply);
+    if (httpReply) {
+        QObject::connect(httpReply, &HttpReply::finished,
+                         [this, req](const HttpReply &reply) { save(req, reply); });
+    }
+    return reply;
+}
+
+void ReplayHttp::save(const HttpRequest &req, const HttpReply &reply) {
+    // network failures are not worth replaying
+    if (reply.statusCode() == 0) return;
+    // revalidations have no body, keep the full response we already have
+    if (reply.statusCode() == 304) return;
+
+    QSaveFile file(fileName(req));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot write" << file.fileName() << file.errorString();
+        return;
+    }
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << fixtureMagic << fixtureVersion << req.url << qint32(reply.statusCode())
+        << reply.reasonPhrase() << reply.headers() << reply.body();
+    if (!file.commit()) qWarning() << "Cannot commit" << file.fileName() << file.errorString();
+}
+
+ReplayHttpReply::ReplayHttpReply(const HttpRequest &req,
+                                 const QString &fileName,
+                                 int latency,
+                                 int bandwidth)
+    : req(req), bandwidth(bandwidth), status(0), sent(0), timer(0) {
+    ReplayHttp::Fixture fixture;
+    if (ReplayHttp::loadFixture(fileName, fixture)) {
+        status = fixture.status;
+        reason = fixture.reason;
+        rawHeaders = fixture.headers;
+        bytes = fixture.body;
+    } else {
+        qWarning() << "No fixture for" << req.url;
+        reason = QStringLiteral("No fixture");
+    }
+    // signals are always emitted from the event loop, as with network replies
+    QTimer::singleShot(latency, this, SLOT(start()));
+}
+
+QByteArray ReplayHttpReply::header(const QByteArray &headerName) const {
+    for (const QNetworkReply::RawHeaderPair &pair : rawHeaders) {
+        if (qstricmp(pair.first.constData(), headerName.constData()) == 0) return pair.second;
+    }
+    return QByteArray();
+}
+
+void ReplayHttpReply::start() {
+    if (bandwidth <= 0 || !isSuccessful()) {
+        sent = bytes.size();
+        if (req.streaming && isSuccessful() && !bytes.isEmpty()) emit chunk(bytes);
+        emitSignals();
+        return;
+    }
+    timer = new QTimer(this);
+    timer->setInterval(chunkInterval);
+    connect(timer, SIGNAL(timeout()), SLOT(sendChunk()));
+    timer->start();
+    sendChunk();
+}
+
+void ReplayHttpReply::sendChunk() {
+    const qint64 chunkSize = qMax(qint64(1), qint64(bandwidth) * chunkInterval / 1000);
+    const int size = int(qMin(qint64(bytes.size() - sent), chunkSize));
+    if (req.streaming && size > 0) emit chunk(bytes.mid(sent, size));
+    sent += size;
+    if (sent < bytes.size()) return;
+    timer->stop();
+    emitSignals();
+}
+
+void ReplayHttpReply::emitSignals() {
+    if (isSuccessful()) {
+        emit data(bytes);
+    } else {
+        emit error(req.url.toString() + QLatin1Char(' ') + QString::number(status) +
+                   QLatin1Char(' ') + reason);
+    }
+    emit finished(*this);
+    deleteLater();
+}
@@ -0,0 +1,77 @@
+#ifndef REPLAYHTTP_H
+#define REPLAYHTTP_H
+
+#include "http.h"
+#include <QtCore>
+#include <QtNetwork>
+
+/**
+ * @brief Records responses to a fixture directory, or replays them without network access.
+ * In Record mode requests go through to the wrapped Http and every response that got an
+ * HTTP status is saved, except 304 Not Modified. In Replay mode responses come from the
+ * fixtures, optionally delayed by a fixed latency and trickled at a limited bandwidth.
+ * Fixtures are matched without the API key. Requests without a fixture fail with status 0.
+ */
+class ReplayHttp : public Http {
+public:
+    enum Mode { Record, Replay };
+
+    // A recorded response
+    struct Fixture {
+        Fixture() : status(0) {}
+        QUrl url;
+        int status;
+        QString reason;
+        QList<QNetworkReply::RawHeaderPair> headers;
+        QByteArray body;
+    };
+    // Also used by the benchmarks to read recorded responses
+    static bool loadFixture(const QString &fileName, Fixture &fixture);
+
+    ReplayHttp(Http &http, const QString &directory, Mode mode);
+    void setLatency(int milliseconds) { latency = milliseconds; }
+    // Bytes per second, 0 means unlimited
+    void setBandwidth(int value) { bandwidth = value; }
+    QObject *request(const HttpRequest &req);
+
+private:
+    QString fileName(const HttpRequest &req) const;
+    void save(const HttpRequest &req, const HttpReply &reply);
+
+    Http &http;
+    QString directory;
+    Mode mode;
+    int latency;
+    int bandwidth;
+};
+
+class ReplayHttpReply : public HttpReply {
+    Q_OBJECT
+
+public:
+    ReplayHttpReply(const HttpRequest &req, const QString &fileName, int latency, int bandwidth);
+    QUrl url() const { return req.url; }
+    int statusCode() const { return status; }
+    QString reasonPhrase() const { return reason; }
+    const QList<QNetworkReply::RawHeaderPair> headers() const { return rawHeaders; }
+    QByteArray header(const QByteArray &headerName) const;
+    QByteArray body() const { return bytes; }
+
+private slots:
+    void start();
+    void sendChunk();
+
+private:
+    void emitSignals();
+
+    const HttpRequest req;
+    int bandwidth;
+    int status;
+    QString reason;
+    QList<QNetworkReply::RawHeaderPair> rawHeaders;
+    QByteArray bytes;
+    int sent;
+    QTimer *timer;
+};
+
+#endif // REPLAYHTTP_H
@@ -0,0 +1,229 @@
+#include "scheduledhttp.h"
+#include "httpstats.h"
+
+ScheduledHttp::ScheduledHttp(Http &http)
+    : http(http), classifier(0), maxRequestsPerHost(4), maxRequests(8), requestsPerSecond(0),
+      burst(1), queues(HttpRequest::IdlePriority + 1), running(0), idleRunning(0),
+      scheduling(false), timerActive(false) {}
+
+void ScheduledHttp::setRateLimit(double requestsPerSecond, int burst) {
+    this->requestsPerSecond = requestsPerSecond;
+    this->burst = qMax(1, burst);
+}
+
+QObject *ScheduledHttp::request(const HttpRequest &req) {
+    HttpRequest scheduledReq = req;
+    if (classifier && req.priority == HttpRequest::NormalPriority)
+        scheduledReq.priority = classifier(req);
+    ScheduledHttpReply *reply = new ScheduledHttpReply(*this, scheduledReq);
+    enqueue(reply);
+    return reply;
+}
+
+bool ScheduledHttp::setPriority(const QUrl &url, HttpRequest::Priority priority) {
+    bool found = false;
+    for (QList<ScheduledHttpReply *> &queue : queues) {
+        for (int i = 0; i < queue.size();) {
+            ScheduledHttpReply *reply = queue.at(i);
+            HttpRequest::Priority newPriority = priority;
+            if (classifier && priority == HttpRequest::NormalPriority)
+                newPriority = classifier(reply->req);
+            if (reply->url() != url || reply->priority() == newPriority) {
+                ++i;
+                continue;
+            }
+            queue.removeAt(i);
+            reply->req.priority = newPriority;
+            queues[newPriority].append(reply);
+            found = true;
+        }
+    }
+    if (found) schedule();
+    return found;
+}
+
+bool ScheduledHttp::drop(const QUrl &url) {
+    bool found = false;
+    for (QList<ScheduledHttpReply *> &queue : queues) {
+        for (int i = 0; i < queue.size();) {
+            ScheduledHttpReply *reply = queue.at(i);
+            if (reply->url() != url) {
+                ++i;
+                continue;
+            }
+            queue.removeAt(i);
+            reply->drop();
+            found = true;
+        }
+    }
+    return found;
+}
+
+int ScheduledHttp::dropAll(HttpRequest::Priority priority) {
+    const QList<ScheduledHttpReply *> queue = queues.at(priority);
+    queues[priority].clear();
+    for (ScheduledHttpReply *reply : queue)
+        reply->drop();
+    if (!queue.isEmpty()) qDebug() << "Dropped" << queue.size() << "requests";
+    return queue.size();
+}
+
+void ScheduledHttp::enqueue(ScheduledHttpReply *reply) {
+    queues[reply->priority()].append(reply);
+    schedule();
+}
+
+void ScheduledHttp::dequeue(ScheduledHttpReply *reply) {
+    queues[reply->priority()].removeOne(reply);
+}
+
+void ScheduledHttp::requestFinished(ScheduledHttpReply *reply) {
+    findHost(reply).running--;
+    running--;
+    if (reply->priority() == HttpRequest::IdlePriority) idleRunning--;
+    schedule();
+}
+
+ScheduledHttp::Host &ScheduledHttp::findHost(const ScheduledHttpReply *reply) {
+    const QString name = reply->url().host();
+    auto i = hosts.find(name);
+    if (i == hosts.end()) {
+        Host host;
+        host.running = 0;
+        host.tokens = burst;
+        host.lastRefill.start();
+        i = hosts.insert(name, host);
+    }
+    return i.value();
+}
+
+bool ScheduledHttp::isBusy() const {
+    if (running > idleRunning) return true;
+    for (int p = 0; p < HttpRequest::IdlePriority; ++p)
+        if (!queues.at(p).isEmpty()) return true;
+    return false;
+}
+
+bool ScheduledHttp::takeToken(Host &host) {
+    if (requestsPerSecond <= 0) return true;
+    host.tokens = qMin(double(burst),
+                       host.tokens + host.lastRefill.restart() * requestsPerSecond / 1000.);
+    if (host.tokens < 1.) return false;
+    host.tokens -= 1.;
+    return true;
+}
+
+qint64 ScheduledHttp::nextTokenDelay(const Host &host) const {
+    return qMax(qint64(1), qint64(qCeil((1. - host.tokens) * 1000. / requestsPerSecond)));
+}
+
+void ScheduledHttp::scheduleLater(qint64 delay) {
+    if (timerActive) return;
+    timerActive = true;
+    QTimer::singleShot(delay, [this]() {
+        timerActive = false;
+        schedule();
+    });
+}
+
+void ScheduledHttp::schedule() {
+    // starting or dropping a request can call us back
+    if (scheduling) return;
+    scheduling = true;
+
+    qint64 delay = -1;
+    for (int p = 0; p < queues.size(); ++p) {
+        if (p == HttpRequest::IdlePriority && isBusy()) break;
+        const bool urgent = p == HttpRequest::HighestPriority;
+        QList<ScheduledHttpReply *> &queue = queues[p];
+        for (int i = 0; i < queue.size();) {
+            if (!urgent && running >= maxRequests) break;
+            ScheduledHttpReply *reply = queue.at(i);
+            Host &host = findHost(reply);
+            if (host.running >= maxRequestsPerHost) {
+                ++i;
+                continue;
+            }
+            if (!takeToken(host)) {
+                const qint64 hostDelay = nextTokenDelay(host);
+                if (delay < 0 || hostDelay < delay) delay = hostDelay;
+                ++i;
+                continue;
+            }
+            queue.removeAt(i);
+            host.running++;
+            running++;
+            if (p == HttpRequest::IdlePriority) idleRunning++;
+            reply->start();
+        }
+    }
+
+    scheduling = false;
+    if (delay >= 0) scheduleLater(delay);
+}
+
+ScheduledHttpReply::ScheduledHttpReply(ScheduledHttp &scheduler, const HttpRequest &req)
+    : scheduler(scheduler), req(req), state(Queued) {
+    queueTimer.start();
+}
+
+ScheduledHttpReply::~ScheduledHttpReply() {
+    if (state == Queued)
+        scheduler.dequeue(this);
+    else if (state == Running)
+        scheduler.requestFinished(this);
+}
+
+QString ScheduledHttpReply::reasonPhrase() const {
+    return state == Dropped ? QStringLiteral("Dropped") : QString();
+}
+
+void ScheduledHttpReply::start() {
+    state = Running;
+    HttpStats::instance().addTime(req.url, HttpStats::QueueTime, queueTimer.elapsed());
+    QObject *reply = scheduler.http.request(req);
+    connect(reply, SIGNAL(data(QByteArray)), SIGNAL(data(QByteArray)));
+    connect(reply, SIGNAL(chunk(QByteArray)), SIGNAL(chunk(QByteArray)));
+    connect(reply, SIGNAL(error(QString)), SIGNAL(error(QString)));
+    connect(reply, SIGNAL(finished(HttpReply)), SIGNAL(finished(HttpReply)));
+    connect(reply, SIGNAL(finished(HttpReply)), SLOT(originFinished()));
+
+    // this will cause the deletion of this object once the request is finished
+    setParent(reply);
+}
+
+void ScheduledHttpReply::abort() {
+    blockSignals(true);
+    if (state == Running) {
+        // the origin is our parent, deleting it deletes us
+        HttpReply *origin = qobject_cast<HttpReply *>(parent());
+        if (origin) {
+            origin->abort();
+            return;
+        }
+    }
+    if (state == Queued) {
+        scheduler.dequeue(this);
+        state = Aborted;
+    }
+    deleteLater();
+}
+
+void ScheduledHttpReply::originFinished() {
+    if (state != Running) return;
+    state = Finished;
+    scheduler.requestFinished(this);
+}
+
+void ScheduledHttpReply::drop() {
+    state = Dropped;
+    // signals are always emitted from the event loop, as with network replies
+    QTimer::singleShot(0, this, SLOT(emitDropped()));
+}
+
+void ScheduledHttpReply::emitDropped() {
+    qDebug() << "Dropped" << req.url;
+    emit error(req.url.toString() + QLatin1String(" Dropped"));
+    emit finished(*this);
+    deleteLater();
+}
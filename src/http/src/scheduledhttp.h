@@ -0,0 +1,101 @@
+#ifndef SCHEDULEDHTTP_H
+#define SCHEDULEDHTTP_H
+
+#include "http.h"
+#include <QtCore>
+#include <QtNetwork>
+
+class ScheduledHttpReply;
+
+/**
+ * @brief Queues requests and starts them in priority order.
+ * Concurrency is limited per host and overall, HighestPriority requests ignore the overall limit.
+ * Each host has a token bucket for rate limiting.
+ * IdlePriority requests only start when nothing else is queued or running.
+ * Not thread-safe.
+ */
+class ScheduledHttp : public Http {
+public:
+    // Decides the priority of requests that don't have an explicit one
+    typedef HttpRequest::Priority (*Classifier)(const HttpRequest &req);
+
+    ScheduledHttp(Http &http = Http::instance());
+    void setMaxRequestsPerHost(int value) { maxRequestsPerHost = value; }
+    void setMaxRequests(int value) { maxRequests = value; }
+    // Allows bursts of burst requests per host, then requestsPerSecond. 0 disables it.
+    void setRateLimit(double requestsPerSecond, int burst);
+    void setClassifier(Classifier value) { classifier = value; }
+    QObject *request(const HttpRequest &req);
+
+    // These only affect requests that have not started yet
+    bool setPriority(const QUrl &url, HttpRequest::Priority priority);
+    bool drop(const QUrl &url);
+    int dropAll(HttpRequest::Priority priority);
+
+private:
+    friend class ScheduledHttpReply;
+    struct Host {
+        int running;
+        double tokens;
+        QElapsedTimer lastRefill;
+    };
+
+    void enqueue(ScheduledHttpReply *reply);
+    void dequeue(ScheduledHttpReply *reply);
+    void requestFinished(ScheduledHttpReply *reply);
+    void schedule();
+    Host &findHost(const ScheduledHttpReply *reply);
+    bool isBusy() const;
+    bool takeToken(Host &host);
+    qint64 nextTokenDelay(const Host &host) const;
+    void scheduleLater(qint64 delay);
+
+    Http &http;
+    Classifier classifier;
+    int maxRequestsPerHost;
+    int maxRequests;
+    double requestsPerSecond;
+    int burst;
+
+    // One queue per priority, oldest first
+    QVector<QList<ScheduledHttpReply *>> queues;
+    QHash<QString, Host> hosts;
+    int running;
+    int idleRunning;
+    bool scheduling;
+    bool timerActive;
+};
+
+class ScheduledHttpReply : public HttpReply {
+    Q_OBJECT
+
+public:
+    ScheduledHttpReply(ScheduledHttp &scheduler, const HttpRequest &req);
+    ~ScheduledHttpReply();
+    QUrl url() const { return req.url; }
+    int statusCode() const { return state == Dropped ? 0 : 200; }
+    QString reasonPhrase() const;
+    QByteArray body() const { return QByteArray(); }
+
+    HttpRequest::Priority priority() const { return req.priority; }
+
+public slots:
+    void abort();
+
+private slots:
+    void originFinished();
+    void emitDropped();
+
+private:
+    friend class ScheduledHttp;
+    enum State { Queued, Running, Finished, Dropped, Aborted };
+    void start();
+    void drop();
+
+    ScheduledHttp &scheduler;
+    HttpRequest req;
+    State state;
+    QElapsedTimer queueTimer;
+};
+
+#endif // SCHEDULEDHTTP_H
@@ -0,0 +1,412 @@
+#include "segmentcachestorage.h"
+
+namespace {
+
+// Record layout: magic, key size, value size (all little endian quint32), key, value.
+// A removal is recorded as a tombstone with no value.
+const quint32 recordMagic = 0x4c435352; // LCSR
+const quint32 tombstone = 0xffffffff;
+const int headerSize = 12;
+
+const quint32 offsetsMagic = 0x4c434f46; // LCOF
+const quint32 offsetsVersion = 1;
+
+qint64 recordSize(int keySize, quint32 valueSize) {
+    return headerSize + keySize + (valueSize == tombstone ? 0 : valueSize);
+}
+}
+
+SegmentCacheStorage::SegmentCacheStorage(const QString &directory)
+    : directory(directory), maxSegmentSize(1024 * 1024 * 16), activeSegment(0),
+      compacting(false) {
+    load();
+}
+
+SegmentCacheStorage::~SegmentCacheStorage() {
+    compaction.waitForFinished();
+    flush();
+    for (Segment &segment : segments)
+        closeSegment(segment);
+}
+
+QString SegmentCacheStorage::segmentPath(quint32 id) const {
+    return directory + QString(QStringLiteral("%1.seg")).arg(id, 8, 10, QLatin1Char('0'));
+}
+
+SegmentCacheStorage::Segment *SegmentCacheStorage::openSegment(quint32 id) {
+    auto i = segments.find(id);
+    if (i != segments.end()) return &i.value();
+
+    QFile *file = new QFile(segmentPath(id));
+    if (!file->open(QIODevice::ReadWrite)) {
+        qWarning() << "Cannot open" << file->fileName() << file->errorString();
+        delete file;
+        return 0;
+    }
+    const Segment segment = {file, 0, 0, file->size(), 0};
+    return &segments.insert(id, segment).value();
+}
+
+void SegmentCacheStorage::closeSegment(Segment &segment) {
+    if (segment.map) segment.file->unmap(segment.map);
+    segment.file->close();
+    delete segment.file;
+    segment.file = 0;
+    segment.map = 0;
+    segment.mapped = 0;
+}
+
+const uchar *SegmentCacheStorage::mapRecord(const Location &location, qint64 size) {
+    auto i = segments.find(location.segment);
+    if (i == segments.end()) return 0;
+    Segment &segment = i.value();
+
+    const qint64 end = location.offset + size;
+    if (!segment.map || segment.mapped < end) {
+        // the segment grew since it was mapped
+        if (segment.map) segment.file->unmap(segment.map);
+        segment.file->flush();
+        segment.map = segment.file->map(0, segment.size);
+        if (!segment.map) {
+            qWarning() << "Cannot map" << segment.file->fileName() << segment.file->errorString();
+            segment.mapped = 0;
+            return 0;
+        }
+        segment.mapped = segment.size;
+        if (segment.mapped < end) return 0;
+    }
+    return segment.map + location.offset;
+}
+
+QByteArray SegmentCacheStorage::readValue(const QByteArray &key, const Location &location) {
+    const qint64 size = recordSize(key.size(), location.size);
+    if (location.segment == activeSegment) {
+        // The active segment keeps growing, remapping it after every write would cost
+        // much more than reading the record
+        auto i = segments.find(location.segment);
+        if (i == segments.end()) return QByteArray();
+        QFile *file = i->file;
+        if (!file->seek(location.offset)) return QByteArray();
+        const QByteArray record = file->read(size);
+        if (record.size() != size ||
+            qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(record.constData())) !=
+                    recordMagic)
+            return QByteArray();
+        return record.mid(headerSize + key.size());
+    }
+
+    // older segments don't change anymore, they're mapped once
+    const uchar *record = mapRecord(location, size);
+    if (!record || qFromLittleEndian<quint32>(record) != recordMagic) return QByteArray();
+    // copy, the mapping can go away with compaction
+    return QByteArray(reinterpret_cast<const char *>(record) + headerSize + key.size(),
+                      location.size);
+}
+
+bool SegmentCacheStorage::append(const QByteArray &key,
+                                 const QByteArray *value,
+                                 Location *location) {
+    const quint32 valueSize = value ? value->size() : tombstone;
+    const qint64 size = recordSize(key.size(), valueSize);
+
+    Segment *segment = openSegment(activeSegment);
+    if (segment && segment->size > 0 && segment->size + size > maxSegmentSize) {
+        segment = openSegment(++activeSegment);
+        saveOffsets();
+    }
+    if (!segment) return false;
+
+    QFile *file = segment->file;
+    if (file->pos() != segment->size && !file->seek(segment->size)) return false;
+
+    uchar header[headerSize];
+    qToLittleEndian(recordMagic, header);
+    qToLittleEndian(quint32(key.size()), header + 4);
+    qToLittleEndian(valueSize, header + 8);
+    bool success = file->write(reinterpret_cast<const char *>(header), headerSize) == headerSize &&
+                   file->write(key) == key.size();
+    if (success && value) success = file->write(*value) == value->size();
+    if (!success) {
+        qWarning() << "Cannot write" << file->fileName() << file->errorString();
+        file->resize(segment->size);
+        return false;
+    }
+
+    location->segment = activeSegment;
+    location->offset = segment->size;
+    location->size = value ? value->size() : 0;
+    segment->size += size;
+    return true;
+}
+
+void SegmentCacheStorage::markDead(const Location &location, int keySize) {
+    auto i = segments.find(location.segment);
+    if (i != segments.end()) i->dead += recordSize(keySize, location.size);
+}
+
+QByteArray SegmentCacheStorage::read(const QByteArray &key) {
+    QMutexLocker locker(&mutex);
+    auto i = locations.constFind(key);
+    if (i == locations.constEnd()) return QByteArray();
+
+    const QByteArray value = readValue(key, *i);
+    if (value.isNull()) qWarning() << "Corrupted record" << key;
+    return value;
+}
+
+bool SegmentCacheStorage::write(const QByteArray &key, const QByteArray &value) {
+    QMutexLocker locker(&mutex);
+    Location location;
+    if (!append(key, &value, &location)) return false;
+
+    auto i = locations.find(key);
+    if (i != locations.end()) {
+        markDead(*i, key.size());
+        *i = location;
+    } else {
+        locations.insert(key, location);
+    }
+    maybeCompact();
+    return true;
+}
+
+void SegmentCacheStorage::remove(const QByteArray &key) {
+    QMutexLocker locker(&mutex);
+    auto i = locations.find(key);
+    if (i == locations.end()) return;
+    markDead(*i, key.size());
+    locations.erase(i);
+
+    // the tombstone makes the removal survive a rescan of the segment
+    Location location;
+    if (append(key, 0, &location)) markDead(location, key.size());
+    maybeCompact();
+}
+
+bool SegmentCacheStorage::clear() {
+    compaction.waitForFinished();
+    QMutexLocker locker(&mutex);
+    for (Segment &segment : segments)
+        closeSegment(segment);
+    segments.clear();
+    locations.clear();
+    activeSegment = 0;
+    const bool success = QDir(directory).removeRecursively();
+    QDir().mkpath(directory);
+    return success;
+}
+
+void SegmentCacheStorage::flush() {
+    QMutexLocker locker(&mutex);
+    saveOffsets();
+}
+
+void SegmentCacheStorage::load() {
+    QDir().mkpath(directory);
+
+    // The offsets file is a snapshot, anything appended after it is found by scanning
+    QHash<quint32, qint64> knownSizes;
+    QHash<quint32, qint64> knownDead;
+    QFile file(directory + QLatin1String("offsets"));
+    if (file.open(QIODevice::ReadOnly)) {
+        QDataStream in(&file);
+        in.setVersion(QDataStream::Qt_5_0);
+        quint32 magic, version, segmentCount, locationCount;
+        in >> magic >> version;
+        if (magic == offsetsMagic && version == offsetsVersion) {
+            in >> activeSegment >> segmentCount;
+            for (quint32 i = 0; i < segmentCount && in.status() == QDataStream::Ok; ++i) {
+                quint32 id;
+                qint64 size, dead;
+                in >> id >> size >> dead;
+                knownSizes.insert(id, size);
+                knownDead.insert(id, dead);
+            }
+            in >> locationCount;
+            for (quint32 i = 0; i < locationCount && in.status() == QDataStream::Ok; ++i) {
+                QByteArray key;
+                Location location;
+                in >> key >> location.segment >> location.offset >> location.size;
+                locations.insert(key, location);
+            }
+        }
+        if (in.status() != QDataStream::Ok || magic != offsetsMagic ||
+            version != offsetsVersion) {
+            qWarning() << "Invalid offsets" << file.fileName();
+            locations.clear();
+            knownSizes.clear();
+            knownDead.clear();
+            activeSegment = 0;
+        }
+        file.close();
+    }
+
+    const QStringList names = QDir(directory).entryList(QStringList(QStringLiteral("*.seg")),
+                                                        QDir::Files, QDir::Name);
+    for (const QString &name : names) {
+        bool ok;
+        const quint32 id = name.left(name.length() - 4).toUInt(&ok);
+        if (!ok) continue;
+        Segment *segment = openSegment(id);
+        if (!segment) continue;
+        if (id > activeSegment) activeSegment = id;
+
+        qint64 from = 0;
+        auto known = knownSizes.constFind(id);
+        if (known != knownSizes.constEnd() && known.value() <= segment->size) {
+            from = known.value();
+            segment->dead = knownDead.value(id);
+        } else if (known != knownSizes.constEnd()) {
+            // shorter than we remember, trust nothing in it
+            for (auto i = locations.begin(); i != locations.end();) {
+                if (i->segment == id)
+                    i = locations.erase(i);
+                else
+                    ++i;
+            }
+        }
+        scanSegment(id, from);
+    }
+
+    // forget records in segments that are gone
+    for (auto i = locations.begin(); i != locations.end();) {
+        if (!segments.contains(i->segment))
+            i = locations.erase(i);
+        else
+            ++i;
+    }
+}
+
+void SegmentCacheStorage::scanSegment(quint32 id, qint64 from) {
+    Segment &segment = segments[id];
+    QFile *file = segment.file;
+    const qint64 end = file->size();
+    qint64 pos = from;
+    file->seek(pos);
+    while (pos < end) {
+        uchar header[headerSize];
+        if (file->read(reinterpret_cast<char *>(header), headerSize) != headerSize) break;
+        if (qFromLittleEndian<quint32>(header) != recordMagic) break;
+        const quint32 keySize = qFromLittleEndian<quint32>(header + 4);
+        const quint32 valueSize = qFromLittleEndian<quint32>(header + 8);
+        const qint64 size = recordSize(keySize, valueSize);
+        if (pos + size > end) break;
+        const QByteArray key = file->read(keySize);
+        if (key.size() != int(keySize)) break;
+
+        auto i = locations.find(key);
+        if (i != locations.end()) {
+            markDead(*i, keySize);
+            locations.erase(i);
+        }
+        if (valueSize == tombstone) {
+            segment.dead += size;
+        } else {
+            const Location location = {id, quint32(pos), valueSize};
+            locations.insert(key, location);
+        }
+
+        pos += size;
+        if (!file->seek(pos)) break;
+    }
+
+    if (pos < end) {
+        // a crash left a partial record at the end
+        qWarning() << "Truncating" << file->fileName() << "at" << pos;
+        file->resize(pos);
+    }
+    segment.size = pos;
+}
+
+void SegmentCacheStorage::saveOffsets() {
+    for (Segment &segment : segments)
+        segment.file->flush();
+
+    QSaveFile file(directory + QLatin1String("offsets"));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot write" << file.fileName() << file.errorString();
+        return;
+    }
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << offsetsMagic << offsetsVersion << activeSegment << quint32(segments.size());
+    for (auto i = segments.constBegin(); i != segments.constEnd(); ++i)
+        out << i.key() << i->size << i->dead;
+    out << quint32(locations.size());
+    for (auto i = locations.constBegin(); i != locations.constEnd(); ++i)
+        out << i.key() << i->segment << i->offset << i->size;
+    if (!file.commit()) qWarning() << "Cannot commit" << file.fileName() << file.errorString();
+}
+
+void SegmentCacheStorage::carryTombstones(quint32 id) {
+    // Tombstones shadow records of older segments that a rescan would bring back.
+    // Keys written again since then don't need them.
+    const qint64 size = segments.value(id).size;
+    const Location start = {id, 0, 0};
+    const uchar *data = mapRecord(start, size);
+    if (!data) return;
+    qint64 pos = 0;
+    while (pos + headerSize <= size) {
+        const uchar *header = data + pos;
+        if (qFromLittleEndian<quint32>(header) != recordMagic) break;
+        const quint32 keySize = qFromLittleEndian<quint32>(header + 4);
+        const quint32 valueSize = qFromLittleEndian<quint32>(header + 8);
+        const qint64 recordEnd = pos + recordSize(keySize, valueSize);
+        if (recordEnd > size) break;
+        if (valueSize == tombstone) {
+            const QByteArray key(reinterpret_cast<const char *>(header) + headerSize, keySize);
+            Location location;
+            if (!locations.contains(key) && append(key, 0, &location))
+                markDead(location, keySize);
+        }
+        pos = recordEnd;
+    }
+}
+
+void SegmentCacheStorage::maybeCompact() {
+    if (compacting) return;
+    for (auto i = segments.constBegin(); i != segments.constEnd(); ++i) {
+        if (i.key() == activeSegment) continue;
+        if (i->dead * 2 < i->size) continue;
+        compacting = true;
+        const quint32 id = i.key();
+        compaction = QtConcurrent::run([this, id] { compact(id); });
+        return;
+    }
+}
+
+void SegmentCacheStorage::compact(quint32 id) {
+    QVector<QByteArray> keys;
+    {
+        QMutexLocker locker(&mutex);
+        for (auto i = locations.constBegin(); i != locations.constEnd(); ++i)
+            if (i->segment == id) keys << i.key();
+    }
+
+    // Move live records one at a time so readers and writers are never blocked for long
+    for (const QByteArray &key : keys) {
+        QMutexLocker locker(&mutex);
+        auto i = locations.find(key);
+        if (i == locations.end() || i->segment != id) continue;
+        const QByteArray value = readValue(key, *i);
+        if (value.isNull()) continue;
+        Location location;
+        if (!append(key, &value, &location)) break;
+        *i = location;
+    }
+
+    QMutexLocker locker(&mutex);
+    bool live = false;
+    for (auto i = locations.constBegin(); i != locations.constEnd() && !live; ++i)
+        live = i->segment == id;
+    auto segment = segments.find(id);
+    if (!live && segment != segments.end()) {
+        if (segments.firstKey() < id) carryTombstones(id);
+        closeSegment(*segment);
+        QFile::remove(segmentPath(id));
+        segments.erase(segment);
+        saveOffsets();
+        qDebug() << "Compacted segment" << id;
+    }
+    compacting = false;
+}
@@ -0,0 +1,64 @@
+#ifndef SEGMENTCACHESTORAGE_H
+#define SEGMENTCACHESTORAGE_H
+
+#include "localcachestorage.h"
+#include <QtConcurrent>
+
+/**
+ * @brief Stores values as records appended to large segment files.
+ * An offset index locates the live records. Full segments are read through memory maps,
+ * the one being appended to with plain reads.
+ * Segments mostly made of dead records are compacted in the background, tombstones are
+ * carried forward while older segments may still hold the records they remove.
+ */
+class SegmentCacheStorage : public LocalCacheStorage {
+public:
+    SegmentCacheStorage(const QString &directory);
+    ~SegmentCacheStorage();
+    void setMaxSegmentSize(qint64 value) { maxSegmentSize = value; }
+
+    QByteArray read(const QByteArray &key);
+    bool write(const QByteArray &key, const QByteArray &value);
+    void remove(const QByteArray &key);
+    bool clear();
+    void flush();
+
+private:
+    struct Location {
+        quint32 segment;
+        quint32 offset;
+        quint32 size;
+    };
+    struct Segment {
+        QFile *file;
+        uchar *map;
+        qint64 mapped;
+        qint64 size;
+        qint64 dead;
+    };
+
+    QString segmentPath(quint32 id) const;
+    Segment *openSegment(quint32 id);
+    void closeSegment(Segment &segment);
+    const uchar *mapRecord(const Location &location, qint64 size);
+    QByteArray readValue(const QByteArray &key, const Location &location);
+    bool append(const QByteArray &key, const QByteArray *value, Location *location);
+    void markDead(const Location &location, int keySize);
+    void load();
+    void scanSegment(quint32 id, qint64 from);
+    void saveOffsets();
+    void maybeCompact();
+    void compact(quint32 id);
+    void carryTombstones(quint32 id);
+
+    QString directory;
+    qint64 maxSegmentSize;
+    QMutex mutex;
+    QHash<QByteArray, Location> locations;
+    QMap<quint32, Segment> segments;
+    quint32 activeSegment;
+    bool compacting;
+    QFuture<void> compaction;
+};
+
+#endif // SEGMENTCACHESTORAGE_H
@@ -1,24 +1,83 @@
 #include "httputils.h"
 #include "constants.h"
 #include "http.h"
-#include "throttledhttp.h"
 #include "cachedhttp.h"
+#include "httpstats.h"
 #include "localcache.h"
+#include "replayhttp.h"
+#include "scheduledhttp.h"
 
-Http &HttpUtils::notCached() {
-    static Http *h = [] {
-        Http *http = new Http;
-        http->addRequestHeader("User-Agent", userAgent());
+namespace {
 
-        return http;
-    }();
+HttpRequest::Priority youTubePriority(const HttpRequest &req) {
+    const QString host = req.url.host();
+    const QString path = req.url.path();
+    if (host.endsWith(QLatin1String("ytimg.com")) || host.endsWith(QLatin1String("ggpht.com")))
+        return HttpRequest::LowPriority;
+    if (path.startsWith(QLatin1String("/youtube/v3/"))) {
+        if (path.endsWith(QLatin1String("/search"))) return HttpRequest::HighPriority;
+        return HttpRequest::NormalPriority;
+    }
+    // get_video_info, watch pages, the JS player and manifests: the user is waiting for these
+    if (host.endsWith(QLatin1String("youtube.com")) ||
+        host.endsWith(QLatin1String("googlevideo.com")))
+        return HttpRequest::HighestPriority;
+    return HttpRequest::NormalPriority;
+}
+
+// Groups requests for HttpStats, so that API calls can be told apart from stream resolution
+QString endpointName(const QUrl &url) {
+    const QString host = url.host();
+    const QString path = url.path();
+    if (host.endsWith(QLatin1String("ytimg.com")) || host.endsWith(QLatin1String("ggpht.com")))
+        return QStringLiteral("thumbnails");
+    if (path.startsWith(QLatin1String("/youtube/v3/"))) return path.mid(12);
+    if (host.endsWith(QLatin1String("googlevideo.com"))) return QStringLiteral("streams");
+    if (host.endsWith(QLatin1String("youtube.com"))) {
+        if (path == QLatin1String("/get_video_info")) return QStringLiteral("get_video_info");
+        if (path == QLatin1String("/watch")) return QStringLiteral("watch");
+        if (path.endsWith(QLatin1String(".js"))) return QStringLiteral("player");
+    }
+    return host;
+}
+
+// MINITUBE_HTTP_RECORD or MINITUBE_HTTP_REPLAY set to a fixture directory
+// put a ReplayHttp at the bottom of every chain, see ReplayHttp.
+// MINITUBE_HTTP_LATENCY (ms) and MINITUBE_HTTP_BANDWIDTH (bytes/s) shape replayed responses.
+Http *createReplayHttp(Http *http) {
+    const QString recordDirectory = QString::fromLocal8Bit(qgetenv("MINITUBE_HTTP_RECORD"));
+    const QString replayDirectory = QString::fromLocal8Bit(qgetenv("MINITUBE_HTTP_REPLAY"));
+    if (!replayDirectory.isEmpty()) {
+        ReplayHttp *replayHttp = new ReplayHttp(*http, replayDirectory, ReplayHttp::Replay);
+        replayHttp->setLatency(qgetenv("MINITUBE_HTTP_LATENCY").toInt());
+        replayHttp->setBandwidth(qgetenv("MINITUBE_HTTP_BANDWIDTH").toInt());
+        return replayHttp;
+    }
+    if (!recordDirectory.isEmpty())
+        return new ReplayHttp(*http, recordDirectory, ReplayHttp::Record);
+    return http;
+}
+
+Http *createHttp(const QByteArray &userAgent) {
+    static bool statsConfigured = false;
+    if (!statsConfigured) {
+        HttpStats::instance().setClassifier(endpointName);
+        statsConfigured = true;
+    }
+    Http *http = new Http;
+    http->addRequestHeader("User-Agent", userAgent);
+    return createReplayHttp(http);
+}
+}
+
+Http &HttpUtils::notCached() {
+    static Http *h = [] { return createHttp(userAgent()); }();
     return *h;
 }
 
 Http &HttpUtils::cached() {
     static Http *h = [] {
-        Http *http = new Http;
-        http->addRequestHeader("User-Agent", userAgent());
+        Http *http = createHttp(userAgent());
 
         CachedHttp *cachedHttp = new CachedHttp(*http, "http");
 
@@ -28,21 +87,76 @@ Http &HttpUtils::cached() {
 }
 
 Http &HttpUtils::yt() {
-    static Http *h = [] {
-        Http *http = new Http;
-        http->addRequestHeader("User-Agent", stealthUserAgent());
+    return ytCache();
+}
 
-        CachedHttp *cachedHttp = new CachedHttp(*http, "yt");
+CachedHttp &HttpUtils::ytCache() {
+    static CachedHttp *h = [] {
+        CachedHttp *cachedHttp = new CachedHttp(scheduler(), "yt");
         cachedHttp->setMaxSeconds(3600);
+        // entries survive API key rotation
+        cachedHttp->getKeyNormalizer().ignoreQueryItem(QStringLiteral("key"),
+                                                       QStringLiteral("/youtube/v3/"));
+        // dead videos, channels and thumbnails are not worth asking for again soon
+        cachedHttp->setFailureSeconds(4, 1800);
+        cachedHttp->setFailureSeconds(5, 60);
 
         return cachedHttp;
     }();
     return *h;
 }
 
+ScheduledHttp &HttpUtils::scheduler() {
+    static ScheduledHttp *h = [] {
+        Http *http = createHttp(stealthUserAgent());
+
+        ScheduledHttp *scheduledHttp = new ScheduledHttp(*http);
+        scheduledHttp->setClassifier(youTubePriority);
+        scheduledHttp->setRateLimit(10, 20);
+
+        return scheduledHttp;
+    }();
+    return *h;
+}
+
+PrefetchGroup *HttpUtils::prefetch(const QList<QUrl> &urls) {
+    QList<HttpRequest> requests;
+    requests.reserve(urls.size());
+    for (const QUrl &url : urls) {
+        HttpRequest req;
+        req.url = url;
+        requests << req;
+    }
+    return ytCache().prefetch(requests);
+}
+
 void HttpUtils::clearCaches() {
     LocalCache::instance("yt")->clear();
     LocalCache::instance("http")->clear();
+    LocalCache::instance("streams")->clear();
+    LocalCache::instance("players")->clear();
+    LocalCache::instance("items")->clear();
+}
+
+void HttpUtils::flushCaches() {
+    LocalCache::instance("yt")->flush();
+    LocalCache::instance("http")->flush();
+    LocalCache::instance("streams")->flush();
+    LocalCache::instance("players")->flush();
+    LocalCache::instance("items")->flush();
+}
+
+QString HttpUtils::statsFileName() {
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+           QLatin1String("/http-stats.txt");
+}
+
+bool HttpUtils::dumpStats() {
+    const QString fileName = statsFileName();
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    const bool success = HttpStats::instance().dump(fileName);
+    if (success) qWarning() << "Http stats written to" << fileName;
+    return success;
 }
 
 const QByteArray &HttpUtils::userAgent() {
@@ -4,6 +4,9 @@
 #include <QtCore>
 
 class Http;
+class CachedHttp;
+class PrefetchGroup;
+class ScheduledHttp;
 
 class HttpUtils {
 
@@ -11,7 +14,16 @@ public:
     static Http &notCached();
     static Http &cached();
     static Http &yt();
+    static CachedHttp &ytCache();
+    // Warms the yt() cache when the network is idle, abort() the group to cancel it
+    static PrefetchGroup *prefetch(const QList<QUrl> &urls);
+    // Where yt() requests wait for their turn, queued requests can be reprioritized or dropped
+    static ScheduledHttp &scheduler();
     static void clearCaches();
+    static void flushCaches();
+    // Request timings per endpoint, see HttpStats
+    static QString statsFileName();
+    static bool dumpStats();
 
     static const QByteArray &userAgent();
     static const QByteArray &stealthUserAgent();
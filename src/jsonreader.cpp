@@ -0,0 +1,216 @@
+#include "jsonreader.h"
+
+namespace {
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+}
+
+JsonReader::JsonReader(const QByteArray &bytes)
+    : p(bytes.constData()), end(bytes.constData() + bytes.size()), name(0), nameSize(0),
+      error(false) {}
+
+bool JsonReader::beginObject() {
+    if (isObject()) {
+        ++p;
+        return true;
+    }
+    skipValue();
+    return false;
+}
+
+bool JsonReader::beginArray() {
+    skipSpace();
+    if (p < end && *p == '[') {
+        ++p;
+        return true;
+    }
+    skipValue();
+    return false;
+}
+
+bool JsonReader::nextName() {
+    if (endOf('}')) return false;
+    const char *start = p;
+    if (*p != '"' || !skipString()) {
+        fail();
+        return false;
+    }
+    name = start + 1;
+    nameSize = p - start - 2;
+    skipSpace();
+    if (p == end || *p != ':') {
+        fail();
+        return false;
+    }
+    ++p;
+    return true;
+}
+
+bool JsonReader::nextElement() {
+    return !endOf(']');
+}
+
+bool JsonReader::nameIs(const char *name) const {
+    return int(qstrlen(name)) == nameSize && memcmp(this->name, name, nameSize) == 0;
+}
+
+bool JsonReader::isString() {
+    skipSpace();
+    return p < end && *p == '"';
+}
+
+bool JsonReader::isObject() {
+    skipSpace();
+    return p < end && *p == '{';
+}
+
+QString JsonReader::readString() {
+    if (!isString()) {
+        skipValue();
+        return QString();
+    }
+
+    const char *start = ++p;
+    const char *run = start;
+    QString s;
+    while (p < end && *p != '"') {
+        if (*p != '\\') {
+            ++p;
+            continue;
+        }
+        s += QString::fromUtf8(run, p - run);
+        if (++p == end) break;
+        const char c = *p++;
+        switch (c) {
+        case 'b':
+            s += QLatin1Char('\b');
+            break;
+        case 'f':
+            s += QLatin1Char('\f');
+            break;
+        case 'n':
+            s += QLatin1Char('\n');
+            break;
+        case 'r':
+            s += QLatin1Char('\r');
+            break;
+        case 't':
+            s += QLatin1Char('\t');
+            break;
+        case 'u': {
+            // surrogate pairs come as two escapes, which is just what QString wants
+            ushort unicode = 0;
+            for (int i = 0; i < 4 && p < end; ++i) {
+                const int digit = hexValue(*p++);
+                if (digit < 0) break;
+                unicode = (unicode << 4) | digit;
+            }
+            s += QChar(unicode);
+            break;
+        }
+        default:
+            s += QLatin1Char(c);
+        }
+        run = p;
+    }
+    if (p >= end) {
+        fail();
+        return QString();
+    }
+
+    // the common case, no escapes
+    if (run == start)
+        s = QString::fromUtf8(start, p - start);
+    else
+        s += QString::fromUtf8(run, p - run);
+    ++p;
+    return s;
+}
+
+void JsonReader::skipValue() {
+    skipSpace();
+    if (p == end) {
+        fail();
+        return;
+    }
+
+    if (*p == '"') {
+        skipString();
+        return;
+    }
+
+    if (*p == '{' || *p == '[') {
+        int depth = 0;
+        while (p < end) {
+            const char c = *p;
+            if (c == '"') {
+                if (!skipString()) return;
+                continue;
+            }
+            ++p;
+            if (c == '{' || c == '[')
+                ++depth;
+            else if ((c == '}' || c == ']') && --depth == 0)
+                return;
+        }
+        fail();
+        return;
+    }
+
+    // numbers, true, false and null
+    while (p < end && *p != ',' && *p != '}' && *p != ']' && !isSpace(*p))
+        ++p;
+}
+
+void JsonReader::skipSpace() {
+    while (p < end && isSpace(*p))
+        ++p;
+}
+
+bool JsonReader::skipString() {
+    // skip the opening quote
+    ++p;
+    while (p < end) {
+        const char c = *p++;
+        if (c == '"') return true;
+        if (c == '\\') ++p;
+    }
+    fail();
+    return false;
+}
+
+bool JsonReader::endOf(char close) {
+    skipSpace();
+    if (p >= end) {
+        // also when reading stopped because of an error
+        fail();
+        return true;
+    }
+    if (*p == close) {
+        ++p;
+        return true;
+    }
+    if (*p == ',') {
+        ++p;
+        skipSpace();
+        if (p == end) {
+            fail();
+            return true;
+        }
+    }
+    return false;
+}
+
+void JsonReader::fail() {
+    error = true;
+    p = end;
+}
@@ -0,0 +1,50 @@
+#ifndef JSONREADER_H
+#define JSONREADER_H
+
+#include <QtCore>
+
+/**
+ * @brief Single pass, pull style JSON reader over UTF-8 bytes.
+ * Nothing is allocated for values that are skipped, so callers pick the few fields they need
+ * out of large responses without building a QJsonDocument.
+ * It is lenient: malformed input ends the reading early but is not otherwise validated.
+ * The bytes are not copied and must outlive the reader.
+ *
+ * Objects are read with beginObject() and then nextName() until it returns false,
+ * reading or skipping each value. Arrays the same way with beginArray() and nextElement().
+ */
+class JsonReader {
+public:
+    JsonReader(const QByteArray &bytes);
+
+    bool hasError() const { return error; }
+
+    // Return false and skip the value if it's not an object or array
+    bool beginObject();
+    bool beginArray();
+    // Return false once the object or array is over
+    bool nextName();
+    bool nextElement();
+    // The name of the current member, names with escapes never match
+    bool nameIs(const char *name) const;
+
+    bool isString();
+    bool isObject();
+    // Returns a null string and skips the value if it's not a string
+    QString readString();
+    void skipValue();
+
+private:
+    void skipSpace();
+    bool skipString();
+    void fail();
+    bool endOf(char close);
+
+    const char *p;
+    const char *end;
+    const char *name;
+    int nameSize;
+    bool error;
+};
+
+#endif // JSONREADER_H
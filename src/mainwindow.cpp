@@ -1111,6 +1111,7 @@ void MainWindow::quit() {
     ChannelAggregator::instance()->stop();
     ChannelAggregator::instance()->cleanup();
     Database::shutdown();
+    HttpUtils::flushCaches();
     qApp->quit();
 }
 
@@ -1881,6 +1882,8 @@ void MainWindow::messageReceived(const QString &message) {
         if (skipBackwardAct->isEnabled()) skipBackwardAct->trigger();
     } else if (message == QLatin1String("--stop-after-this")) {
         getAction("stopafterthis")->toggle();
+    } else if (message == QLatin1String("--dump-http-stats")) {
+        HttpUtils::dumpStats();
     } else if (message.startsWith("--")) {
         MainWindow::printHelp();
     } else if (!message.isEmpty()) {
@@ -1943,6 +1946,8 @@ void MainWindow::printHelp() {
     msg += "Go back to the previous video.\n";
     msg += "  --stop-after-this\t";
     msg += "Stop playback at the end of the video.\n";
+    msg += "  --dump-http-stats\t";
+    msg += "Write network timings to http-stats.txt in the cache folder.\n";
     std::cout << msg.toLocal8Bit().data();
 }
 
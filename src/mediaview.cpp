@@ -31,6 +31,7 @@ $END_LICENSE */
 #include "refinesearchwidget.h"
 #include "sidebarheader.h"
 #include "sidebarwidget.h"
+#include "streamurlcache.h"
 #include "temporary.h"
 #include "videoareawidget.h"
 #ifdef APP_ACTIVATION
@@ -301,6 +302,8 @@ void MediaView::disappear() {
 
 void MediaView::handleError(const QString &message) {
     qWarning() << __PRETTY_FUNCTION__ << message;
+    // don't retry with the same URL
+    if (!currentVideoId.isEmpty()) StreamUrlCache::instance().remove(currentVideoId);
 #ifdef APP_PHONON_SEEK
     mediaObject->play();
 #else
@@ -343,7 +346,7 @@ void MediaView::pause() {
             pauseTimer.invalidate();
             connect(playlistModel->activeVideo(), SIGNAL(gotStreamUrl(QUrl)),
                     SLOT(resumeWithNewStreamUrl(QUrl)));
-            playlistModel->activeVideo()->loadStreamUrl();
+            playlistModel->activeVideo()->loadStreamUrl(true);
         } else
             mediaObject->play();
         break;
@@ -20,20 +20,121 @@ $END_LICENSE */
 
 #include "paginatedvideosource.h"
 
-#include "yt3.h"
+#include "yt3batcher.h"
 #include "yt3listparser.h"
 #include "datautils.h"
 
 #include "video.h"
 #include "http.h"
 #include "httputils.h"
+#include "cachedhttp.h"
+#include "parseutils.h"
+
+namespace {
+
+struct VideoDetails {
+    QString id;
+    int duration;
+    int viewCount;
+};
+
+// Runs on the thread pool
+QVector<VideoDetails> parseDetails(const QByteArray &bytes) {
+    QVector<VideoDetails> details;
+    QJsonDocument doc = QJsonDocument::fromJson(bytes);
+    QJsonObject obj = doc.object();
+
+    QJsonValue items = obj["items"];
+    if (items.isArray()) {
+        const auto array = items.toArray();
+        details.reserve(array.size());
+        for (const QJsonValue &v : array) {
+            if (!v.isObject()) continue;
+
+            QJsonObject item = v.toObject();
+
+            VideoDetails d;
+            d.id = item["id"].toString();
+
+            QString isoPeriod = item["contentDetails"].toObject()["duration"].toString();
+            d.duration = DataUtils::parseIsoPeriod(isoPeriod);
+
+            d.viewCount = item["statistics"].toObject()["viewCount"].toString().toInt();
+            details << d;
+        }
+    }
+    return details;
+}
+}
 
 PaginatedVideoSource::PaginatedVideoSource(QObject *parent) : VideoSource(parent)
   , tokenTimestamp(0)
   , reloadingToken(false)
   , currentMax(0)
   , currentStartIndex(0)
-  , asyncDetails(false) { }
+  , asyncDetails(false)
+  , generation(0) { }
+
+QObject *PaginatedVideoSource::request(const QUrl &url) {
+    return track(HttpUtils::yt().get(url));
+}
+
+QObject *PaginatedVideoSource::track(QObject *reply) {
+    // forget finished requests
+    for (int i = requests.size() - 1; i >= 0; --i)
+        if (!requests.at(i)) requests.remove(i);
+
+    requests << reply;
+    return reply;
+}
+
+void PaginatedVideoSource::abortRequests() {
+    // parses still running on the thread pool belong to the old requests
+    generation++;
+    if (prefetchGroup) prefetchGroup->abort();
+    prefetchedPageToken.clear();
+
+    const QVector<QPointer<QObject> > replies = requests;
+    requests.clear();
+    for (const QPointer<QObject> &p : replies) {
+        HttpReply *reply = qobject_cast<HttpReply *>(p.data());
+        if (reply) reply->abort();
+    }
+}
+
+void PaginatedVideoSource::prefetchNextPage() {
+    if (nextPageToken.isEmpty() || lastUrl.isEmpty() || isPageTokenExpired()) return;
+    if (nextPageToken == prefetchedPageToken) return;
+    prefetchedPageToken = nextPageToken;
+
+    QUrl url = lastUrl;
+    QUrlQuery q(url);
+    q.removeAllQueryItems(QStringLiteral("pageToken"));
+    q.addQueryItem(QStringLiteral("pageToken"), nextPageToken);
+    url.setQuery(q);
+    prefetchGroup = HttpUtils::prefetch(QList<QUrl>() << url);
+}
+
+QVector<Video*> PaginatedVideoSource::createVideos(const YT3ListParser &parser) {
+    QVector<Video *> videos;
+    videos.reserve(parser.getRecords().size());
+    for (const YT3VideoRecord &record : parser.getRecords()) {
+        Video *video = new Video();
+        video->setId(record.id);
+        video->setPublished(record.published);
+        video->setChannelId(record.channelId);
+        video->setTitle(record.title);
+        video->setDescription(record.description);
+        video->setThumbnailUrl(record.thumbnailUrl);
+        video->setMediumThumbnailUrl(record.mediumThumbnailUrl);
+        video->setLargeThumbnailUrl(record.largeThumbnailUrl);
+        video->setChannelTitle(record.channelTitle);
+        if (record.duration >= 0) video->setDuration(record.duration);
+        if (record.viewCount >= 0) video->setViewCount(record.viewCount);
+        videos.append(video);
+    }
+    return videos;
+}
 
 bool PaginatedVideoSource::hasMoreVideos() {
     qDebug() << __PRETTY_FUNCTION__ << nextPageToken;
@@ -82,20 +183,19 @@ bool PaginatedVideoSource::isPageTokenExpired() {
 
 void PaginatedVideoSource::reloadToken() {
     qDebug() << "Reloading pageToken";
-    QObject *reply = HttpUtils::yt().get(lastUrl);
+    QObject *reply = request(lastUrl);
     connect(reply, SIGNAL(data(QByteArray)), SLOT(parseResults(QByteArray)));
     connect(reply, SIGNAL(error(QString)), SLOT(requestError(QString)));
 }
 
 void PaginatedVideoSource::loadVideoDetails(const QVector<Video*> &videos) {
     this->videos = videos;
-    QString videoIds;
-    videoIds.reserve(videos.size()*12);
+    QStringList videoIds;
+    videoIds.reserve(videos.size());
     videoMap.reserve(videos.size());
     for (Video *video : videos) {
         // TODO get video details from cache
-        if (!videoIds.isEmpty()) videoIds += QLatin1Char(',');
-        videoIds += video->getId();
+        videoIds << video->getId();
         videoMap.insert(video->getId(), video);
     }
 
@@ -107,50 +207,33 @@ void PaginatedVideoSource::loadVideoDetails(const QVector<Video*> &videos) {
         return;
     }
 
-    QUrl url = YT3::instance().method("videos");
-    QUrlQuery q(url);
-    q.addQueryItem(QStringLiteral("part"), QStringLiteral("contentDetails,statistics"));
-    q.addQueryItem(QStringLiteral("id"), videoIds);
-    url.setQuery(q);
-
-    QObject *reply = HttpUtils::yt().get(url);
+    // shared with the other sources loading details at the same time
+    QObject *reply = track(YT3Batcher::instance().request(
+            QStringLiteral("videos"), QStringLiteral("contentDetails,statistics"), videoIds));
     connect(reply, SIGNAL(data(QByteArray)), SLOT(parseVideoDetails(QByteArray)));
     connect(reply, SIGNAL(error(QString)), SLOT(requestError(QString)));
 }
 
 void PaginatedVideoSource::parseVideoDetails(const QByteArray &bytes) {
-    QJsonDocument doc = QJsonDocument::fromJson(bytes);
-    QJsonObject obj = doc.object();
-
-    QJsonValue items = obj["items"];
-    if (items.isArray()) {
-        const auto array = items.toArray();
-        for (const QJsonValue &v : array) {
-            if (!v.isObject()) continue;
-
-            QJsonObject item = v.toObject();
-
-            QString id = item["id"].toString();
-            Video *video = videoMap.value(id);
+    const uint generation = this->generation;
+    ParseUtils::run(this, bytes, parseDetails,
+                    [this, generation](const QVector<VideoDetails> &details) {
+        if (generation != this->generation) return;
+        for (const VideoDetails &d : details) {
+            Video *video = videoMap.value(d.id);
             if (!video) {
-                qWarning() << "No video for id" << id;
+                qWarning() << "No video for id" << d.id;
                 continue;
             }
-
-            QString isoPeriod = item["contentDetails"].toObject()["duration"].toString();
-            int duration = DataUtils::parseIsoPeriod(isoPeriod);
-            video->setDuration(duration);
-
-            int viewCount = item["statistics"].toObject()["viewCount"].toString().toInt();
-            video->setViewCount(viewCount);
-
+            video->setDuration(d.duration);
+            video->setViewCount(d.viewCount);
             // TODO cache by etag?
         }
-    }
-    if (!asyncDetails) {
-        emit gotVideos(videos);
-        emit finished(videos.size());
-    } else {
-        emit gotDetails();
-    }
+        if (!asyncDetails) {
+            emit gotVideos(videos);
+            emit finished(videos.size());
+        } else {
+            emit gotDetails();
+        }
+    });
 }
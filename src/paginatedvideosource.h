@@ -23,6 +23,9 @@ $END_LICENSE */
 
 #include "videosource.h"
 
+class PrefetchGroup;
+class YT3ListParser;
+
 class PaginatedVideoSource : public VideoSource {
 
     Q_OBJECT
@@ -37,6 +40,8 @@ public:
     void reloadToken();
     void setAsyncDetails(bool value) { asyncDetails = value; }
     void loadVideoDetails(const QVector<Video*> &videos);
+    // Warms the cache with the page after the last one loaded
+    void prefetchNextPage();
 
 signals:
     void gotDetails();
@@ -45,6 +50,13 @@ protected slots:
     void parseVideoDetails(const QByteArray &bytes);
 
 protected:
+    // Requests made through this are stopped by abortRequests()
+    QObject *request(const QUrl &url);
+    QObject *track(QObject *reply);
+    void abortRequests();
+    // New Video objects, owned by the caller and living on the calling thread
+    static QVector<Video*> createVideos(const YT3ListParser &parser);
+
     QString nextPageToken;
     uint tokenTimestamp;
     QUrl lastUrl;
@@ -54,6 +66,11 @@ protected:
     QVector<Video*> videos;
     QHash<QString, Video*> videoMap;
     bool asyncDetails;
+    QVector<QPointer<QObject> > requests;
+    QPointer<PrefetchGroup> prefetchGroup;
+    QString prefetchedPageToken;
+    // Bumped by abortRequests(), parse results of an older generation are dropped
+    uint generation;
 
 };
 
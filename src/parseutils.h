@@ -0,0 +1,32 @@
+#ifndef PARSEUTILS_H
+#define PARSEUTILS_H
+
+#include <QtCore>
+#include <QtConcurrent>
+
+class ParseUtils {
+
+public:
+    /**
+     * Runs parse(bytes) on the global thread pool, then done(result) on the calling thread.
+     * done is not called if context is destroyed in the meantime. parse must not touch QObjects
+     * living on the calling thread and its result must be default constructible and copyable.
+     */
+    template <typename Parse, typename Done>
+    static void run(QObject *context, const QByteArray &bytes, Parse parse, Done done) {
+        typedef decltype(parse(bytes)) Result;
+        QPointer<QObject> guard(context);
+        QFutureWatcher<Result> *watcher = new QFutureWatcher<Result>();
+        QObject::connect(watcher, &QFutureWatcher<Result>::finished, [watcher, guard, done] {
+            watcher->deleteLater();
+            if (guard) done(watcher->result());
+        });
+        watcher->setFuture(QtConcurrent::run([parse, bytes] { return parse(bytes); }));
+    }
+
+private:
+    ParseUtils() { }
+
+};
+
+#endif // PARSEUTILS_H
@@ -26,7 +26,6 @@ $END_LICENSE */
 #include "videosource.h"
 #include "ytsearch.h"
 
-static const int maxItems = 50;
 static const QString recentKeywordsKey = "recentKeywords";
 static const QString recentChannelsKey = "recentChannels";
 
@@ -133,6 +132,27 @@ void PlaylistModel::setActiveRow(int row, bool notify) {
         m_activeRow = -1;
         m_activeVideo = 0;
     }
+    lookAhead();
+}
+
+void PlaylistModel::lookAhead() {
+    // "streamLookAhead" is how many of the next videos get their stream URL in advance
+    const int rows = QSettings().value("streamLookAhead", 2).toInt();
+    QVector<QPointer<Video>> upcoming;
+    // with nothing playing nextRow() is the first row, which may never be played
+    const int next = m_activeRow == -1 ? -1 : nextRow();
+    if (next != -1) {
+        for (int row = next; row < next + rows && rowExists(row); ++row)
+            upcoming << videoAt(row);
+    }
+
+    // the playlist changed, stop what's not coming next anymore
+    for (const QPointer<Video> &video : lookAheadVideos)
+        if (video && !upcoming.contains(video)) video->abortStreamUrlPrefetch();
+    lookAheadVideos = upcoming;
+
+    for (const QPointer<Video> &video : upcoming)
+        video->prefetchStreamUrl();
 }
 
 int PlaylistModel::nextRow() const {
@@ -190,8 +210,15 @@ void PlaylistModel::searchMore() {
 
 void PlaylistModel::searchNeeded() {
     const int desiredRowsAhead = 10;
+    const int prefetchRowsAhead = 25;
     int remainingRows = videos.size() - m_activeRow;
-    if (remainingRows < desiredRowsAhead) searchMore(maxItems);
+    if (remainingRows < desiredRowsAhead) {
+        searchMore(maxItems);
+    } else if (remainingRows < prefetchRowsAhead && canSearchMore && !searching) {
+        // so that the next page is already cached when it's needed
+        PaginatedVideoSource *source = qobject_cast<PaginatedVideoSource *>(videoSource);
+        if (source) source->prefetchNextPage();
+    }
 }
 
 void PlaylistModel::abortSearch() {
@@ -235,6 +262,7 @@ void PlaylistModel::addVideos(const QVector<Video *> &newVideos) {
         connect(video, SIGNAL(gotThumbnail()), SLOT(updateVideoSender()), Qt::UniqueConnection);
         video->loadThumbnail();
     }
+    lookAhead();
 }
 
 void PlaylistModel::handleFirstVideo(Video *video) {
@@ -331,6 +359,11 @@ void PlaylistModel::removeIndexes(QModelIndexList &indexes) {
     }
     qDeleteAll(delitems);
     videos.squeeze();
+
+    // fix m_activeRow after all this, unless the active video itself is gone
+    const int activeRow = videos.indexOf(m_activeVideo);
+    if (activeRow != -1) m_activeRow = activeRow;
+    lookAhead();
 }
 
 // --- Sturm und drang ---
@@ -407,6 +440,7 @@ bool PlaylistModel::dropMimeData(const QMimeData *data,
 
     // fix m_activeRow after all this
     m_activeRow = videos.indexOf(m_activeVideo);
+    lookAhead();
 
     // let the MediaView restore the selection
     emit needSelectionFor(droppedVideos);
@@ -463,6 +497,11 @@ void PlaylistModel::move(QModelIndexList &indexes, bool up) {
         endInsertRows();
     }
 
+    // fix m_activeRow after all this
+    const int activeRow = videos.indexOf(m_activeVideo);
+    if (activeRow != -1) m_activeRow = activeRow;
+    lookAhead();
+
     emit needSelectionFor(movedVideos);
 }
 
@@ -48,6 +48,9 @@ class PlaylistModel : public QAbstractListModel {
     Q_OBJECT
 
 public:
+    // Videos requested per page
+    static const int maxItems = 50;
+
     PlaylistModel(QWidget *parent = 0);
 
     int rowCount(const QModelIndex &parent = QModelIndex()) const;
@@ -108,6 +111,8 @@ signals:
 private:
     void handleFirstVideo(Video* video);
     void searchMore(int max);
+    // Resolves stream URLs of the videos after nextRow() in the background
+    void lookAhead();
 
     VideoSource *videoSource;
     bool searching;
@@ -120,6 +125,7 @@ private:
 
     int m_activeRow;
     Video *m_activeVideo;
+    QVector<QPointer<Video>> lookAheadVideos;
 
     QString errorMessage;
 
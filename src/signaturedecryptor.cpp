@@ -0,0 +1,372 @@
+#include "signaturedecryptor.h"
+#include "jsfunctions.h"
+#include "localcache.h"
+
+#include <algorithm>
+
+namespace {
+static const QString jsNameChars = "a-zA-Z0-9\\$_";
+// Players kept in memory
+const int maxDecryptors = 3;
+// Of the persisted decryptors
+const quint32 formatVersion = 2;
+}
+
+QSharedPointer<SignatureDecryptor> SignatureDecryptor::forPlayer(const QString &playerUrl) {
+    QSharedPointer<SignatureDecryptor> decryptor = decryptors().value(playerUrl);
+    if (decryptor) return decryptor;
+
+    const QByteArray value = cache()->value(playerUrl.toUtf8());
+    if (value.isEmpty()) return decryptor;
+    QDataStream in(value);
+    in.setVersion(QDataStream::Qt_5_0);
+    quint32 version;
+    QString functionName;
+    QStringList snippets;
+    QString ops;
+    in >> version;
+    if (version != formatVersion) return decryptor;
+    in >> functionName >> snippets >> ops;
+    if (in.status() != QDataStream::Ok || functionName.isEmpty()) return decryptor;
+
+    decryptor = QSharedPointer<SignatureDecryptor>(
+            new SignatureDecryptor(playerUrl, functionName, snippets));
+    // they were checked against the player before being saved
+    decryptor->ops = opsFromString(ops);
+    decryptor->opsVerified = true;
+    decryptor->saved = true;
+    registerDecryptor(decryptor);
+    qDebug() << "Loaded signature decryptor for" << playerUrl << ops;
+    return decryptor;
+}
+
+QSharedPointer<SignatureDecryptor> SignatureDecryptor::create(const QString &playerUrl,
+                                                              const QString &player) {
+    // QRegExp funcNameRe("[\"']signature[\"']\\s*,\\s*([" + jsNameChars + "]+)\\(");
+    static const QRegExp funcNameRe(
+            JsFunctions::instance()->signatureFunctionNameRE().arg(jsNameChars));
+
+    QString functionName;
+    QStringList snippets;
+    QVector<Op> ops;
+    if (funcNameRe.indexIn(player) == -1) {
+        qWarning() << "Cannot capture signature function name" << playerUrl;
+    } else {
+        functionName = funcNameRe.cap(1);
+        QHash<QString, QString> functions;
+        QHash<QString, QString> objects;
+        captureFunction(functionName, player, functions, objects);
+        // objects first, functions refer to them
+        snippets << objects.values() << functions.values();
+        ops = analyze(functionName, functions, objects);
+        if (ops.isEmpty()) qDebug() << "Unknown signature function, using the JS engine";
+    }
+
+    QSharedPointer<SignatureDecryptor> decryptor(
+            new SignatureDecryptor(playerUrl, functionName, snippets));
+    decryptor->ops = ops;
+    decryptor->player = player;
+    registerDecryptor(decryptor);
+    return decryptor;
+}
+
+SignatureDecryptor::SignatureDecryptor(const QString &playerUrl,
+                                       const QString &functionName,
+                                       const QStringList &snippets)
+    : playerUrl(playerUrl), functionName(functionName), snippets(snippets), opsVerified(false),
+      engine(0), saved(false), playerEngine(0) {}
+
+SignatureDecryptor::~SignatureDecryptor() {
+    delete engine;
+    delete playerEngine;
+}
+
+QString SignatureDecryptor::decrypt(const QString &s) {
+    if (opsVerified && !ops.isEmpty()) return transform(s);
+
+    QJSValue sigFunction = jsFunction();
+#ifndef QT_NO_DEBUG_OUTPUT
+    QElapsedTimer timer;
+    timer.start();
+#endif
+    QJSValue value = sigFunction.call(QJSValueList() << s);
+    if (!value.isUndefined() && !value.isError()) {
+        const QString result = value.toString();
+#ifndef QT_NO_DEBUG_OUTPUT
+        const qint64 jsTime = timer.nsecsElapsed();
+        timer.restart();
+#endif
+        // the first time the native transform is checked against the player
+        if (!ops.isEmpty()) {
+            opsVerified = transform(s) == result;
+#ifndef QT_NO_DEBUG_OUTPUT
+            qDebug() << "Signature decrypted in" << jsTime << "ns with the JS engine,"
+                     << timer.nsecsElapsed() << "ns natively";
+#endif
+            if (!opsVerified) {
+                qWarning() << "Native signature transform disagrees with the player"
+                           << opsToString(ops);
+                ops.clear();
+            }
+        }
+        if (!saved) save();
+        // the fallback is not needed
+        player.clear();
+        return result;
+    }
+    qWarning() << "Cannot decrypt signature with" << functionName << value.toString();
+
+    if (!playerEngine && !player.isEmpty()) {
+        playerEngine = new QJSEngine();
+        playerEngine->evaluate(player);
+        player.clear();
+    }
+    if (playerEngine) {
+        value = playerEngine->globalObject().property(functionName).call(QJSValueList() << s);
+        if (!value.isUndefined() && !value.isError()) return value.toString();
+        qWarning() << "Cannot decrypt signature with the whole player" << value.toString();
+    }
+
+    // the next video will download the player again
+    if (saved) forget();
+    return QString();
+}
+
+QJSValue SignatureDecryptor::jsFunction() {
+    if (engine || functionName.isEmpty()) return function;
+    engine = new QJSEngine();
+    for (const QString &f : snippets) {
+        QJSValue value = engine->evaluate(f);
+        if (value.isError()) qWarning() << "Error in" << f << value.toString();
+    }
+    function = engine->globalObject().property(functionName);
+    return function;
+}
+
+QString SignatureDecryptor::transform(const QString &s) const {
+    QString a = s;
+    for (const Op &op : ops) {
+        switch (op.type) {
+        case Op::Reverse:
+            std::reverse(a.begin(), a.end());
+            break;
+        case Op::Splice:
+            a.remove(0, op.argument);
+            break;
+        case Op::Swap:
+            if (!a.isEmpty()) {
+                const int i = op.argument % a.length();
+                const QChar c = a.at(0);
+                a[0] = a.at(i);
+                a[i] = c;
+            }
+            break;
+        }
+    }
+    return a;
+}
+
+QVector<SignatureDecryptor::Op> SignatureDecryptor::analyze(
+        const QString &functionName,
+        const QHash<QString, QString> &functions,
+        const QHash<QString, QString> &objects) {
+    // Xy=function(a){a=a.split("");Ab.cd(a,3);Ab.ef(a,45);return a.join("")}
+    const QString function = functions.value(functionName);
+    const int bodyStart = function.indexOf(QLatin1Char('{'));
+    const int bodyEnd = function.lastIndexOf(QLatin1Char('}'));
+    if (bodyStart == -1 || bodyEnd <= bodyStart) return QVector<Op>();
+    const QStringList statements = function.mid(bodyStart + 1, bodyEnd - bodyStart - 1)
+                                           .split(QLatin1Char(';'), QString::SkipEmptyParts);
+
+    static const QRegExp splitRe(QString("[%1]+=[%1]+\\.split\\(\"\"\\)").arg(jsNameChars));
+    static const QRegExp joinRe(QString("return [%1]+\\.join\\(\"\"\\)").arg(jsNameChars));
+    static const QRegExp callRe(
+            QString("([%1]+)\\.([%1]+)\\([%1]+,(\\d+)\\)").arg(jsNameChars));
+
+    QVector<Op> ops;
+    bool split = false;
+    bool joined = false;
+    for (const QString &s : statements) {
+        const QString statement = s.trimmed();
+        if (!split && splitRe.exactMatch(statement)) {
+            split = true;
+        } else if (split && !joined && joinRe.exactMatch(statement)) {
+            joined = true;
+        } else if (split && !joined && callRe.exactMatch(statement)) {
+            Op op;
+            if (!parseMethod(objects.value(callRe.cap(1)), callRe.cap(2), op.type)) {
+                qDebug() << "Unknown signature operation" << statement;
+                return QVector<Op>();
+            }
+            op.argument = callRe.cap(3).toInt();
+            ops << op;
+        } else {
+            qDebug() << "Unknown signature statement" << statement;
+            return QVector<Op>();
+        }
+    }
+    if (!joined) return QVector<Op>();
+    return ops;
+}
+
+bool SignatureDecryptor::parseMethod(const QString &object, const QString &name, Op::Type &type) {
+    // var Ab={cd:function(a,b){a.splice(0,b)},ef:function(a){a.reverse()},
+    // gh:function(a,b){var c=a[0];a[0]=a[b%a.length];a[b%a.length]=c}};
+    QRegExp re(QLatin1String("[{,\\s][\"']?") + QRegExp::escape(name) +
+               QLatin1String("[\"']?\\s*:\\s*function\\s*\\([^\\)]*\\)\\s*\\{([^\\}]*)\\}"));
+    if (re.indexIn(object) == -1) return false;
+    const QString body = re.cap(1);
+    if (body.contains(QLatin1String(".reverse()")))
+        type = Op::Reverse;
+    else if (body.contains(QLatin1String(".splice(0,")))
+        type = Op::Splice;
+    else if (body.contains(QLatin1Char('%')) && body.contains(QLatin1String(".length")))
+        type = Op::Swap;
+    else
+        return false;
+    return true;
+}
+
+QString SignatureDecryptor::opsToString(const QVector<Op> &ops) {
+    QString s;
+    for (const Op &op : ops) {
+        if (!s.isEmpty()) s += QLatin1Char(' ');
+        switch (op.type) {
+        case Op::Reverse:
+            s += QLatin1Char('r');
+            break;
+        case Op::Splice:
+            s += QLatin1Char('s') + QString::number(op.argument);
+            break;
+        case Op::Swap:
+            s += QLatin1Char('w') + QString::number(op.argument);
+            break;
+        }
+    }
+    return s;
+}
+
+QVector<SignatureDecryptor::Op> SignatureDecryptor::opsFromString(const QString &s) {
+    QVector<Op> ops;
+    const QStringList tokens = s.split(QLatin1Char(' '), QString::SkipEmptyParts);
+    for (const QString &token : tokens) {
+        Op op;
+        const QChar c = token.at(0);
+        if (c == QLatin1Char('r'))
+            op.type = Op::Reverse;
+        else if (c == QLatin1Char('s'))
+            op.type = Op::Splice;
+        else if (c == QLatin1Char('w'))
+            op.type = Op::Swap;
+        else
+            return QVector<Op>();
+        op.argument = token.mid(1).toInt();
+        ops << op;
+    }
+    return ops;
+}
+
+void SignatureDecryptor::captureFunction(const QString &name,
+                                         const QString &js,
+                                         QHash<QString, QString> &functions,
+                                         QHash<QString, QString> &objects) {
+    qDebug() << __PRETTY_FUNCTION__ << name;
+    const QString argsAndBody =
+            QLatin1String("\\s*\\([") + jsNameChars + QLatin1String(",\\s]*\\)\\s*\\{[^\\}]+\\}");
+    QString func;
+    QRegExp funcRe(QLatin1String("function\\s+") + QRegExp::escape(name) + argsAndBody);
+    if (funcRe.indexIn(js) != -1) {
+        func = funcRe.cap(0);
+    } else {
+        // try var foo = function(bar) { };
+        funcRe = QRegExp(QLatin1String("var\\s+") + QRegExp::escape(name) +
+                         QLatin1String("\\s*=\\s*function") + argsAndBody);
+        if (funcRe.indexIn(js) != -1) {
+            func = funcRe.cap(0);
+        } else {
+            // try ,gr= function(bar) { };
+            funcRe = QRegExp(QLatin1String("[,\\s;}\\.\\)](") + QRegExp::escape(name) +
+                             QLatin1String("\\s*=\\s*function") + argsAndBody + ")");
+            if (funcRe.indexIn(js) != -1) {
+                func = funcRe.cap(1);
+            } else {
+                qWarning() << "Cannot capture function" << name;
+                return;
+            }
+        }
+    }
+    functions.insert(name, func);
+
+    // capture inner functions
+    static const QRegExp invokedFuncRe(QLatin1String("[\\s=;\\(]([") + jsNameChars +
+                                       QLatin1String("]+)\\s*\\([") + jsNameChars +
+                                       QLatin1String(",\\s]+\\)"));
+    int pos = name.length() + 9;
+    while ((pos = invokedFuncRe.indexIn(func, pos)) != -1) {
+        QString funcName = invokedFuncRe.cap(1);
+        if (!functions.contains(funcName)) captureFunction(funcName, js, functions, objects);
+        pos += invokedFuncRe.matchedLength();
+    }
+
+    // capture referenced objects
+    static const QRegExp objRe(QLatin1String("[\\s=;\\(]([") + jsNameChars +
+                               QLatin1String("]+)\\.[") + jsNameChars + QLatin1String("]+"));
+    pos = name.length() + 9;
+    while ((pos = objRe.indexIn(func, pos)) != -1) {
+        QString objName = objRe.cap(1);
+        if (!objects.contains(objName)) captureObject(objName, js, objects);
+        pos += objRe.matchedLength();
+    }
+}
+
+void SignatureDecryptor::captureObject(const QString &name,
+                                       const QString &js,
+                                       QHash<QString, QString> &objects) {
+    QRegExp re(QLatin1String("var\\s+") + QRegExp::escape(name) +
+               QLatin1String("\\s*=\\s*\\{.*\\}\\s*;"));
+    re.setMinimal(true);
+    if (re.indexIn(js) == -1) {
+        qWarning() << "Cannot capture object" << name;
+        return;
+    }
+    QString obj = re.cap(0);
+    objects.insert(name, obj);
+}
+
+LocalCache *SignatureDecryptor::cache() {
+    return LocalCache::instance("players");
+}
+
+QHash<QString, QSharedPointer<SignatureDecryptor>> &SignatureDecryptor::decryptors() {
+    static QHash<QString, QSharedPointer<SignatureDecryptor>> decryptors;
+    return decryptors;
+}
+
+void SignatureDecryptor::registerDecryptor(const QSharedPointer<SignatureDecryptor> &decryptor) {
+    // oldest first
+    static QStringList order;
+    order.removeOne(decryptor->playerUrl);
+    order << decryptor->playerUrl;
+    decryptors().insert(decryptor->playerUrl, decryptor);
+    while (order.size() > maxDecryptors)
+        decryptors().remove(order.takeFirst());
+}
+
+void SignatureDecryptor::save() {
+    QByteArray value;
+    QDataStream out(&value, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_0);
+    // unverified operations are not worth saving
+    out << formatVersion << functionName << snippets
+        << (opsVerified ? opsToString(ops) : QString());
+    cache()->insert(playerUrl.toUtf8(), value);
+    saved = true;
+}
+
+void SignatureDecryptor::forget() {
+    qDebug() << "Forgetting signature decryptor for" << playerUrl;
+    decryptors().remove(playerUrl);
+    // an empty value is never loaded
+    cache()->insert(playerUrl.toUtf8(), QByteArray());
+    saved = false;
+}
@@ -0,0 +1,82 @@
+#ifndef SIGNATUREDECRYPTOR_H
+#define SIGNATUREDECRYPTOR_H
+
+#include <QtCore>
+#include <QJSEngine>
+
+class LocalCache;
+
+/**
+ * @brief Deciphers the "s" signatures of stream URLs for one version of the JS player.
+ * The few functions involved are captured from the player once and shared by all the videos
+ * using that player. They are usually a sequence of reverse, splice and swap operations:
+ * when recognized they run natively, once checked against the JS engine on first use.
+ * Otherwise they are evaluated in a JS engine that is kept warm.
+ * Decryptors that worked are persisted, keyed by player URL, and reused after a restart
+ * without downloading the player again.
+ * Not thread-safe.
+ */
+class SignatureDecryptor {
+public:
+    // Null if the player was never seen, download it and create() one then
+    static QSharedPointer<SignatureDecryptor> forPlayer(const QString &playerUrl);
+    static QSharedPointer<SignatureDecryptor> create(const QString &playerUrl,
+                                                     const QString &player);
+
+    ~SignatureDecryptor();
+    // Returns a null string on failure
+    QString decrypt(const QString &s);
+
+private:
+    // Checks the native transform against the JS engine, see benchmarks/signature
+    friend class SignatureBenchmark;
+
+    // A step of the signature transform, see analyze()
+    struct Op {
+        enum Type { Reverse, Splice, Swap };
+        Type type;
+        int argument;
+    };
+
+    SignatureDecryptor(const QString &playerUrl,
+                       const QString &functionName,
+                       const QStringList &snippets);
+    static LocalCache *cache();
+    static QHash<QString, QSharedPointer<SignatureDecryptor>> &decryptors();
+    static void registerDecryptor(const QSharedPointer<SignatureDecryptor> &decryptor);
+    static void captureFunction(const QString &name,
+                                const QString &js,
+                                QHash<QString, QString> &functions,
+                                QHash<QString, QString> &objects);
+    static void captureObject(const QString &name,
+                              const QString &js,
+                              QHash<QString, QString> &objects);
+    // Empty if the signature function is not made of known operations
+    static QVector<Op> analyze(const QString &functionName,
+                               const QHash<QString, QString> &functions,
+                               const QHash<QString, QString> &objects);
+    static bool parseMethod(const QString &object, const QString &name, Op::Type &type);
+    static QString opsToString(const QVector<Op> &ops);
+    static QVector<Op> opsFromString(const QString &s);
+    QString transform(const QString &s) const;
+    // Evaluates the snippets the first time
+    QJSValue jsFunction();
+    void save();
+    void forget();
+
+    const QString playerUrl;
+    const QString functionName;
+    // The captured objects and functions, persisted along with the function name
+    const QStringList snippets;
+    QVector<Op> ops;
+    bool opsVerified;
+    QJSEngine *engine;
+    QJSValue function;
+    bool saved;
+
+    // The whole player, kept as a fallback until the captured functions are known to work
+    QString player;
+    QJSEngine *playerEngine;
+};
+
+#endif // SIGNATUREDECRYPTOR_H
@@ -19,8 +19,11 @@ along with Minitube.  If not, see <http://www.gnu.org/licenses/>.
 $END_LICENSE */
 
 #include "standardfeedsview.h"
+#include "cachedhttp.h"
+#include "httputils.h"
 #include "mainwindow.h"
 #include "painterutils.h"
+#include "playlistmodel.h"
 #include "videosourcewidget.h"
 #include "ytcategories.h"
 #include "ytregions.h"
@@ -32,6 +35,11 @@ StandardFeedsView::StandardFeedsView(QWidget *parent) : View(parent), layout(0)
     setPalette(p);
     setAutoFillBackground(true);
 
+    prefetchTimer = new QTimer(this);
+    prefetchTimer->setSingleShot(true);
+    prefetchTimer->setInterval(500);
+    connect(prefetchTimer, SIGNAL(timeout()), SLOT(prefetchFeed()));
+
     connect(MainWindow::instance()->getAction("worldwideRegion"), SIGNAL(triggered()),
             SLOT(selectWorldwideRegion()));
 
@@ -70,8 +78,33 @@ void StandardFeedsView::layoutCategories(const QVector<YTCategory> &categories)
     if (categories.size() > 1) setUpdatesEnabled(true);
 }
 
+bool StandardFeedsView::eventFilter(QObject *obj, QEvent *event) {
+    // a feed the mouse rests on is likely to be opened, every feed would cost too much quota
+    if (event->type() == QEvent::Enter) {
+        VideoSourceWidget *w = qobject_cast<VideoSourceWidget *>(obj);
+        if (w) {
+            prefetchWidget = w;
+            prefetchTimer->start();
+        }
+    } else if (event->type() == QEvent::Leave) {
+        prefetchTimer->stop();
+    }
+    return View::eventFilter(obj, event);
+}
+
+void StandardFeedsView::prefetchFeed() {
+    if (!prefetchWidget) return;
+    YTStandardFeed *feed = qobject_cast<YTStandardFeed *>(prefetchWidget->getVideoSource());
+    if (!feed) return;
+    if (prefetchGroup) prefetchGroup->abort();
+    // the same first page opening the feed would load, cached pages are skipped
+    const QUrl url = feed->firstPageUrl(PlaylistModel::maxItems);
+    prefetchGroup = HttpUtils::prefetch(QList<QUrl>() << url);
+}
+
 void StandardFeedsView::addVideoSourceWidget(VideoSource *videoSource) {
     VideoSourceWidget *w = new VideoSourceWidget(videoSource);
+    w->installEventFilter(this);
     connect(w, SIGNAL(activated(VideoSource *)), SIGNAL(activated(VideoSource *)));
     connect(w, SIGNAL(unavailable(VideoSourceWidget *)),
             SLOT(removeVideoSourceWidget(VideoSourceWidget *)));
@@ -138,6 +171,8 @@ void StandardFeedsView::appear() {
 }
 
 void StandardFeedsView::disappear() {
+    prefetchTimer->stop();
+    if (prefetchGroup) prefetchGroup->abort();
     QAction *regionAction = MainWindow::instance()->getRegionAction();
     MainWindow::instance()->showActionInStatusBar(regionAction, false);
 }
@@ -29,6 +29,7 @@ class VideoSource;
 struct YTCategory;
 class YTStandardFeed;
 class VideoSourceWidget;
+class PrefetchGroup;
 
 class StandardFeedsView : public View {
     Q_OBJECT
@@ -46,12 +47,14 @@ public slots:
 
 protected:
     void paintEvent(QPaintEvent *event);
+    bool eventFilter(QObject *obj, QEvent *event);
 
 private slots:
     void layoutCategories(const QVector<YTCategory> &categories);
     void selectWorldwideRegion();
     void selectLocalRegion();
     void removeVideoSourceWidget(VideoSourceWidget *videoSourceWidget);
+    void prefetchFeed();
 
 private:
     void resetLayout();
@@ -59,6 +62,9 @@ private:
     YTStandardFeed *
     buildStandardFeed(const QString &feedId, const QString &label, QString time = QString());
     QGridLayout *layout;
+    QTimer *prefetchTimer;
+    QPointer<VideoSourceWidget> prefetchWidget;
+    QPointer<PrefetchGroup> prefetchGroup;
 };
 
 #endif // CATEGORIESVIEW_H
@@ -0,0 +1,61 @@
+#include "streamurlcache.h"
+#include "localcache.h"
+
+namespace {
+
+// Leaves time for the player to open the stream and buffer
+const uint safetyMargin = 5 * 60;
+}
+
+StreamUrlCache &StreamUrlCache::instance() {
+    static StreamUrlCache *i = new StreamUrlCache();
+    return *i;
+}
+
+StreamUrlCache::StreamUrlCache() : cache(LocalCache::instance("streams")) {
+    // entries have their own expiry, this only bounds how long dead ones take space
+    cache->setMaxSeconds(86400);
+    cache->setMaxSize(1024 * 1024);
+}
+
+QByteArray StreamUrlCache::key(const QString &videoId) {
+    const QString definitionName = QSettings().value("definition", "360p").toString();
+    return videoId.toUtf8() + '|' + definitionName.toUtf8();
+}
+
+QUrl StreamUrlCache::value(const QString &videoId, uint validFor, int *definitionCode) {
+    // expiry, definition code and URL separated by spaces
+    const QByteArray value = cache->value(key(videoId));
+    const QList<QByteArray> fields = value.split(' ');
+    if (fields.size() != 3) return QUrl();
+
+    const uint now = QDateTime::currentDateTime().toTime_t();
+    if (fields.at(0).toUInt() < now + validFor + safetyMargin) return QUrl();
+
+    if (definitionCode) *definitionCode = fields.at(1).toInt();
+    return QUrl::fromEncoded(fields.at(2), QUrl::StrictMode);
+}
+
+void StreamUrlCache::insert(const QString &videoId, const QUrl &url, int definitionCode) {
+    const uint expire = expiry(url);
+    if (expire == 0) return;
+    cache->insert(key(videoId), QByteArray::number(expire) + ' ' +
+                                        QByteArray::number(definitionCode) + ' ' +
+                                        url.toEncoded());
+}
+
+void StreamUrlCache::remove(const QString &videoId) {
+    // an empty value never parses as an entry
+    cache->insert(key(videoId), QByteArray());
+}
+
+uint StreamUrlCache::expiry(const QUrl &url) {
+    const QString expire = QUrlQuery(url).queryItemValue(QStringLiteral("expire"));
+    if (!expire.isEmpty()) return expire.toUInt();
+
+    // DASH manifests have their parameters in the path
+    const QStringList path = url.path().split(QLatin1Char('/'));
+    const int i = path.indexOf(QStringLiteral("expire"));
+    if (i != -1 && i + 1 < path.size()) return path.at(i + 1).toUInt();
+    return 0;
+}
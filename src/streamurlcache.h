@@ -0,0 +1,33 @@
+#ifndef STREAMURLCACHE_H
+#define STREAMURLCACHE_H
+
+#include <QtCore>
+
+class LocalCache;
+
+/**
+ * @brief Resolved stream URLs by video ID and preferred definition, persisted across restarts.
+ * Signed googlevideo URLs carry their own expiry time, entries are good until then.
+ * URLs without one, e.g. local DASH manifests, are not cached.
+ */
+class StreamUrlCache {
+public:
+    static StreamUrlCache &instance();
+
+    // An empty URL unless the cached one stays valid for at least validFor seconds
+    QUrl value(const QString &videoId, uint validFor, int *definitionCode);
+    void insert(const QString &videoId, const QUrl &url, int definitionCode);
+    // E.g. when the URL stopped working because our IP address changed
+    void remove(const QString &videoId);
+
+    // Seconds since the epoch, 0 if the URL doesn't say
+    static uint expiry(const QUrl &url);
+
+private:
+    StreamUrlCache();
+    static QByteArray key(const QString &videoId);
+
+    LocalCache *cache;
+};
+
+#endif // STREAMURLCACHE_H
@@ -23,15 +23,21 @@ $END_LICENSE */
 #include "http.h"
 #include "httputils.h"
 #include "jsfunctions.h"
+#include "streamurlcache.h"
 #include "videodefinition.h"
 #include "ytvideo.h"
 
 Video::Video()
     : duration(0), viewCount(-1), license(LicenseYouTube), definitionCode(0),
-      loadingThumbnail(false), ytVideo(0) {}
+      loadingThumbnail(false), ytVideo(0), prefetchingStreamUrl(false),
+      streamUrlPrefetched(false) {}
 
 Video::~Video() {
     qDebug() << "Deleting" << id;
+    abortStreamUrlPrefetch();
+    // nobody is going to see it
+    HttpReply *reply = qobject_cast<HttpReply *>(thumbnailReply.data());
+    if (reply) reply->abort();
 }
 
 Video *Video::clone() {
@@ -81,6 +87,7 @@ void Video::loadThumbnail() {
     if (thumbnailUrl.isEmpty() || loadingThumbnail) return;
     loadingThumbnail = true;
     QObject *reply = HttpUtils::yt().get(thumbnailUrl);
+    thumbnailReply = reply;
     connect(reply, SIGNAL(data(QByteArray)), SLOT(setThumbnail(QByteArray)));
 }
 
@@ -108,19 +115,99 @@ void Video::setThumbnail(const QByteArray &bytes) {
 void Video::streamUrlLoaded(const QUrl &streamUrl) {
     definitionCode = ytVideo->getDefinitionCode();
     this->streamUrl = streamUrl;
-    emit gotStreamUrl(this->streamUrl);
+    StreamUrlCache::instance().insert(id, streamUrl, definitionCode);
+    // a prefetched URL is kept for when the video is played, the cache may not take it
+    if (prefetchingStreamUrl) {
+        prefetchingStreamUrl = false;
+        streamUrlPrefetched = true;
+    } else
+        emit gotStreamUrl(this->streamUrl);
     delete ytVideo;
     ytVideo = 0;
 }
 
-void Video::loadStreamUrl() {
+void Video::emitStreamUrl() {
+    emit gotStreamUrl(streamUrl);
+}
+
+void Video::loadStreamUrl(bool fresh) {
+    if (fresh) {
+        streamUrlPrefetched = false;
+        StreamUrlCache::instance().remove(id);
+    }
+
     if (ytVideo) {
-        qDebug() << "Already loading" << id;
+        if (prefetchingStreamUrl) {
+            // somebody is waiting for it now
+            qDebug() << "Already prefetching" << id;
+            prefetchingStreamUrl = false;
+            ytVideo->setIdlePriority(false);
+        } else
+            qDebug() << "Already loading" << id;
         return;
     }
+
+    if (streamUrlPrefetched) {
+        streamUrlPrefetched = false;
+        // fresh enough unless it says it's expired
+        const uint expiry = StreamUrlCache::expiry(streamUrl);
+        if (expiry == 0 || expiry > QDateTime::currentDateTime().toTime_t()) {
+            qDebug() << "Prefetched stream URL for" << id;
+            QTimer::singleShot(0, this, SLOT(emitStreamUrl()));
+            return;
+        }
+    }
+
+    // the URL has to last until the end of the video
+    int cachedDefinitionCode = 0;
+    const QUrl cachedUrl = StreamUrlCache::instance().value(id, duration, &cachedDefinitionCode);
+    if (!cachedUrl.isEmpty()) {
+        qDebug() << "Cached stream URL for" << id;
+        definitionCode = cachedDefinitionCode;
+        streamUrl = cachedUrl;
+        // signals are always emitted from the event loop, as when loading
+        QTimer::singleShot(0, this, SLOT(emitStreamUrl()));
+        return;
+    }
+
+    createYTVideo();
+    ytVideo->loadStreamUrl();
+}
+
+void Video::prefetchStreamUrl() {
+    if (ytVideo || streamUrlPrefetched) return;
+    if (!StreamUrlCache::instance().value(id, duration, 0).isEmpty()) return;
+
+    qDebug() << "Prefetching stream URL for" << id;
+    prefetchingStreamUrl = true;
+    createYTVideo();
+    ytVideo->setIdlePriority(true);
+    ytVideo->loadStreamUrl();
+}
+
+void Video::abortStreamUrlPrefetch() {
+    if (!ytVideo || !prefetchingStreamUrl) return;
+    qDebug() << "Aborting stream URL prefetch for" << id;
+    prefetchingStreamUrl = false;
+    ytVideo->abort();
+    delete ytVideo;
+    ytVideo = 0;
+}
+
+void Video::createYTVideo() {
     ytVideo = new YTVideo(id, this);
     connect(ytVideo, &YTVideo::gotStreamUrl, this, &Video::streamUrlLoaded);
-    connect(ytVideo, &YTVideo::errorStreamUrl, this, &Video::errorStreamUrl);
+    connect(ytVideo, &YTVideo::errorStreamUrl, this, &Video::streamUrlFailed);
     connect(ytVideo, &YTVideo::errorStreamUrl, ytVideo, &QObject::deleteLater);
-    ytVideo->loadStreamUrl();
+}
+
+void Video::streamUrlFailed(const QString &message) {
+    // it deletes itself
+    ytVideo = 0;
+    // a failed prefetch is retried when the video is played
+    if (prefetchingStreamUrl) {
+        prefetchingStreamUrl = false;
+        return;
+    }
+    emit errorStreamUrl(message);
 }
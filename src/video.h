@@ -77,7 +77,12 @@ public:
 
     int getDefinitionCode() const { return definitionCode; }
 
-    void loadStreamUrl();
+    // A fresh URL skips the cached and prefetched ones, e.g. when they may have gone stale
+    void loadStreamUrl(bool fresh = false);
+    // Resolves the stream URL ahead of time when the network is idle, see PlaylistModel
+    void prefetchStreamUrl();
+    // Only stops a prefetch nobody asked for yet
+    void abortStreamUrlPrefetch();
     const QUrl &getStreamUrl() { return streamUrl; }
 
     const QString &getId() const { return id; }
@@ -96,8 +101,12 @@ signals:
 private slots:
     void setThumbnail(const QByteArray &bytes);
     void streamUrlLoaded(const QUrl &streamUrl);
+    void emitStreamUrl();
+    void streamUrlFailed(const QString &message);
 
 private:
+    void createYTVideo();
+
     QString title;
     QString description;
     QString channelTitle;
@@ -119,8 +128,12 @@ private:
     int definitionCode;
 
     bool loadingThumbnail;
+    QPointer<QObject> thumbnailReply;
 
     YTVideo *ytVideo;
+    bool prefetchingStreamUrl;
+    // streamUrl was prefetched and nobody played it yet
+    bool streamUrlPrefetched;
 };
 
 // This is required in order to use QPointer<Video> as a QVariant
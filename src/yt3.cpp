@@ -6,6 +6,7 @@
 #include "jsfunctions.h"
 #include "http.h"
 #include "httputils.h"
+#include "scheduledhttp.h"
 #include "constants.h"
 #include "mainwindow.h"
 
@@ -77,7 +78,8 @@ void YT3::testApiKey() {
     q.addQueryItem("chart", "mostPopular");
     q.addQueryItem("maxResults", "1");
     url.setQuery(q);
-    QObject *reply = HttpUtils::yt().get(url);
+    // straight to the network, a cached answer says nothing about this key
+    QObject *reply = HttpUtils::scheduler().get(url);
     connect(reply, SIGNAL(finished(HttpReply)), SLOT(testResponse(HttpReply)));
 }
 
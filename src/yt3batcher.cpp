@@ -0,0 +1,178 @@
+#include "yt3batcher.h"
+
+#include "httputils.h"
+#include "localcache.h"
+#include "parseutils.h"
+#include "scheduledhttp.h"
+#include "yt3.h"
+
+namespace {
+
+// Runs on the thread pool
+QHash<QString, QByteArray> parseItems(const QByteArray &bytes) {
+    QHash<QString, QByteArray> items;
+    const QJsonArray array =
+            QJsonDocument::fromJson(bytes).object().value(QLatin1String("items")).toArray();
+    for (const QJsonValue &v : array) {
+        const QJsonObject item = v.toObject();
+        items.insert(item.value(QLatin1String("id")).toString(),
+                     QJsonDocument(item).toJson(QJsonDocument::Compact));
+    }
+    return items;
+}
+}
+
+YT3Batcher &YT3Batcher::instance() {
+    static YT3Batcher *i = new YT3Batcher();
+    return *i;
+}
+
+YT3Batcher::YT3Batcher()
+    : cache(LocalCache::instance("items")), timer(new QTimer(this)), window(50) {
+    // as long as the responses they come from would be
+    cache->setMaxSeconds(3600);
+    cache->setMaxSize(1024 * 1024 * 10);
+    timer->setSingleShot(true);
+    connect(timer, SIGNAL(timeout()), SLOT(flush()));
+}
+
+QObject *YT3Batcher::request(const QString &method, const QString &part, const QStringList &ids) {
+    QUrl url(YT3::baseUrl() + method);
+    QUrlQuery q(url);
+    q.addQueryItem(QStringLiteral("part"), part);
+    q.addQueryItem(QStringLiteral("id"), ids.join(QLatin1Char(',')));
+    url.setQuery(q);
+    YT3BatchReply *reply = new YT3BatchReply(url, ids);
+
+    const QString key = method + QLatin1Char('|') + part;
+    for (const QString &id : ids) {
+        const QByteArray item = cache->value(itemKey(method, part, id));
+        if (!item.isEmpty()) {
+            reply->items.insert(id, item);
+            continue;
+        }
+        Batch &batch = batches[key];
+        if (batch.ids.contains(id)) {
+            attach(batch, reply);
+            continue;
+        }
+        if (batch.ids.size() == maxIds) {
+            send(batch);
+            batch = Batch();
+        }
+        batch.method = method;
+        batch.part = part;
+        batch.ids << id;
+        attach(batch, reply);
+    }
+
+    if (reply->pendingBatches == 0) {
+        // signals are always emitted from the event loop, as with network replies
+        QTimer::singleShot(0, reply, SLOT(emitData()));
+    } else if (!timer->isActive())
+        timer->start(window);
+    return reply;
+}
+
+QByteArray YT3Batcher::itemKey(const QString &method, const QString &part, const QString &id) {
+    return method.toUtf8() + '|' + part.toUtf8() + '|' + id.toUtf8();
+}
+
+void YT3Batcher::flush() {
+    const QHash<QString, Batch> pending = batches;
+    batches.clear();
+    for (const Batch &batch : pending)
+        send(batch);
+}
+
+void YT3Batcher::attach(Batch &batch, YT3BatchReply *reply) {
+    for (const QPointer<YT3BatchReply> &p : batch.replies)
+        if (p == reply) return;
+    batch.replies << reply;
+    reply->pendingBatches++;
+}
+
+void YT3Batcher::send(const Batch &batch) {
+    QVector<QPointer<YT3BatchReply>> replies;
+    for (const QPointer<YT3BatchReply> &p : batch.replies)
+        if (p) replies << p;
+    // everybody aborted while we were waiting
+    if (replies.isEmpty()) return;
+
+    const QStringList &ids = batch.ids;
+    QUrl url = YT3::instance().method(batch.method);
+    QUrlQuery q(url);
+    q.addQueryItem(QStringLiteral("part"), batch.part);
+    q.addQueryItem(QStringLiteral("id"), ids.join(QLatin1Char(',')));
+    url.setQuery(q);
+    qDebug() << "Batching" << ids.size() << batch.method << "for" << replies.size() << "callers";
+
+    // batches are one-offs, their items are cached instead
+    HttpReply *reply = qobject_cast<HttpReply *>(HttpUtils::scheduler().get(url));
+    if (!reply) {
+        // from the event loop, send() can run before the caller connects to its reply
+        for (const QPointer<YT3BatchReply> &p : replies)
+            QTimer::singleShot(0, p, [p] {
+                if (p) p->fail(QStringLiteral("Cannot request ") + p->url().toString());
+            });
+        return;
+    }
+    const QString method = batch.method;
+    const QString part = batch.part;
+    QObject::connect(reply, &HttpReply::data,
+                     [this, replies, method, part](const QByteArray &bytes) {
+        ParseUtils::run(this, bytes, parseItems,
+                        [this, replies, method, part](const QHash<QString, QByteArray> &items) {
+                            for (auto i = items.constBegin(); i != items.constEnd(); ++i)
+                                cache->insert(itemKey(method, part, i.key()), i.value());
+                            for (const QPointer<YT3BatchReply> &p : replies)
+                                if (p) p->addItems(items);
+                        });
+    });
+    QObject::connect(reply, &HttpReply::error, [replies](const QString &message) {
+        for (const QPointer<YT3BatchReply> &p : replies)
+            if (p) p->fail(message);
+    });
+}
+
+YT3BatchReply::YT3BatchReply(const QUrl &url, const QStringList &ids)
+    : requestUrl(url), ids(ids), pendingBatches(0), done(false), status(0) {}
+
+void YT3BatchReply::addItems(const QHash<QString, QByteArray> &batchItems) {
+    if (done) return;
+    for (const QString &id : ids) {
+        auto i = batchItems.constFind(id);
+        if (i != batchItems.constEnd()) items.insert(id, i.value());
+    }
+    if (--pendingBatches == 0) emitData();
+}
+
+void YT3BatchReply::emitData() {
+    if (done) return;
+    done = true;
+
+    // same shape as the API response, items in the order they were asked for
+    bytes = "{\"items\":[";
+    bool first = true;
+    for (const QString &id : ids) {
+        auto i = items.constFind(id);
+        if (i == items.constEnd()) continue;
+        if (!first) bytes += ',';
+        bytes += i.value();
+        first = false;
+    }
+    bytes += "]}";
+    status = 200;
+
+    emit data(bytes);
+    emit finished(*this);
+    deleteLater();
+}
+
+void YT3BatchReply::fail(const QString &message) {
+    if (done) return;
+    done = true;
+    emit error(message);
+    emit finished(*this);
+    deleteLater();
+}
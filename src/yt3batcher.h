@@ -0,0 +1,77 @@
+#ifndef YT3BATCHER_H
+#define YT3BATCHER_H
+
+#include <QtCore>
+#include "http.h"
+
+class LocalCache;
+class YT3BatchReply;
+
+/**
+ * @brief Combines lookups by ID (videos, channels...) made within a short window into
+ * requests of up to maxIds IDs, the most the YouTube Data API accepts per call.
+ * Each caller gets its own reply, whose data() is a response with just the items it asked for.
+ * Items are cached one by one, so IDs already seen are not requested again whatever batch
+ * they came in.
+ */
+class YT3Batcher : public QObject {
+    Q_OBJECT
+
+public:
+    static YT3Batcher &instance();
+    static const int maxIds = 50;
+
+    // How long lookups are collected before being sent
+    void setWindow(int milliseconds) { window = milliseconds; }
+    QObject *request(const QString &method, const QString &part, const QStringList &ids);
+
+private slots:
+    void flush();
+
+private:
+    YT3Batcher();
+    struct Batch {
+        QString method;
+        QString part;
+        QStringList ids;
+        QVector<QPointer<YT3BatchReply>> replies;
+    };
+    static QByteArray itemKey(const QString &method, const QString &part, const QString &id);
+    void attach(Batch &batch, YT3BatchReply *reply);
+    void send(const Batch &batch);
+
+    LocalCache *cache;
+    QTimer *timer;
+    int window;
+    // Not sent yet, keyed by method and part
+    QHash<QString, Batch> batches;
+};
+
+class YT3BatchReply : public HttpReply {
+    Q_OBJECT
+
+public:
+    YT3BatchReply(const QUrl &url, const QStringList &ids);
+    QUrl url() const { return requestUrl; }
+    int statusCode() const { return status; }
+    QByteArray body() const { return bytes; }
+
+private slots:
+    void emitData();
+
+private:
+    friend class YT3Batcher;
+    void addItems(const QHash<QString, QByteArray> &batchItems);
+    void fail(const QString &message);
+
+    const QUrl requestUrl;
+    const QStringList ids;
+    // JSON of each item
+    QHash<QString, QByteArray> items;
+    int pendingBatches;
+    bool done;
+    int status;
+    QByteArray bytes;
+};
+
+#endif // YT3BATCHER_H
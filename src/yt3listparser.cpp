@@ -1,72 +1,117 @@
 #include "yt3listparser.h"
 #include "datautils.h"
-#include "video.h"
+#include "jsonreader.h"
 
 YT3ListParser::YT3ListParser(const QByteArray &bytes) {
-    QJsonDocument doc = QJsonDocument::fromJson(bytes);
-    QJsonObject obj = doc.object();
-
-    nextPageToken = obj[QLatin1String("nextPageToken")].toString();
-
-    const QJsonArray items = obj[QLatin1String("items")].toArray();
-    videos.reserve(items.size());
-    for (const QJsonValue &v : items) {
-        QJsonObject item = v.toObject();
-        parseItem(item);
+    // Only the fields we need are decoded, everything else is skipped in place
+    JsonReader reader(bytes);
+    if (!reader.beginObject()) return;
+    while (reader.nextName()) {
+        if (reader.nameIs("nextPageToken"))
+            nextPageToken = reader.readString();
+        else if (reader.nameIs("items")) {
+            if (!reader.beginArray()) continue;
+            records.reserve(50);
+            while (reader.nextElement())
+                parseItem(reader);
+        } else
+            reader.skipValue();
     }
+    if (reader.hasError()) qWarning() << "Malformed response, got" << records.size() << "videos";
 }
 
-void YT3ListParser::parseItem(const QJsonObject &item) {
-    Video *video = new Video();
-
-    QJsonValue id = item[QLatin1String("id")];
-    if (id.isString())
-        video->setId(id.toString());
-    else {
-        QString videoId = id.toObject()[QLatin1String("videoId")].toString();
-        video->setId(videoId);
+void YT3ListParser::parseItem(JsonReader &reader) {
+    if (!reader.beginObject()) return;
+
+    YT3VideoRecord record;
+    QString liveBroadcastContent;
+    QString publishedAt;
+    QString isoPeriod;
+    QString viewCount;
+    bool hasContentDetails = false;
+    bool hasStatistics = false;
+
+    while (reader.nextName()) {
+        if (reader.nameIs("id")) {
+            if (reader.isString())
+                record.id = reader.readString();
+            else if (reader.beginObject()) {
+                while (reader.nextName()) {
+                    if (reader.nameIs("videoId"))
+                        record.id = reader.readString();
+                    else
+                        reader.skipValue();
+                }
+            }
+        } else if (reader.nameIs("snippet")) {
+            if (!reader.beginObject()) continue;
+            while (reader.nextName()) {
+                if (reader.nameIs("liveBroadcastContent"))
+                    liveBroadcastContent = reader.readString();
+                else if (reader.nameIs("publishedAt"))
+                    publishedAt = reader.readString();
+                else if (reader.nameIs("channelId"))
+                    record.channelId = reader.readString();
+                else if (reader.nameIs("title"))
+                    record.title = reader.readString();
+                else if (reader.nameIs("description"))
+                    record.description = reader.readString();
+                else if (reader.nameIs("channelTitle"))
+                    record.channelTitle = reader.readString();
+                else if (reader.nameIs("thumbnails")) {
+                    if (!reader.beginObject()) continue;
+                    while (reader.nextName()) {
+                        if (reader.nameIs("medium"))
+                            record.thumbnailUrl = parseThumbnailUrl(reader);
+                        else if (reader.nameIs("high"))
+                            record.mediumThumbnailUrl = parseThumbnailUrl(reader);
+                        else if (reader.nameIs("standard"))
+                            record.largeThumbnailUrl = parseThumbnailUrl(reader);
+                        else
+                            reader.skipValue();
+                    }
+                } else
+                    reader.skipValue();
+            }
+        } else if (reader.nameIs("contentDetails")) {
+            hasContentDetails = reader.isObject();
+            if (!reader.beginObject()) continue;
+            while (reader.nextName()) {
+                if (reader.nameIs("duration"))
+                    isoPeriod = reader.readString();
+                else
+                    reader.skipValue();
+            }
+        } else if (reader.nameIs("statistics")) {
+            hasStatistics = reader.isObject();
+            if (!reader.beginObject()) continue;
+            while (reader.nextName()) {
+                if (reader.nameIs("viewCount"))
+                    viewCount = reader.readString();
+                else
+                    reader.skipValue();
+            }
+        } else
+            reader.skipValue();
     }
 
-    QJsonObject snippet = item[QLatin1String("snippet")].toObject();
-
-    bool isLiveBroadcastContent =
-            snippet[QLatin1String("liveBroadcastContent")].toString() != QLatin1String("none");
-    if (isLiveBroadcastContent) {
-        delete video;
-        return;
-    }
-
-    QString publishedAt = snippet[QLatin1String("publishedAt")].toString();
-    QDateTime publishedDateTime = QDateTime::fromString(publishedAt, Qt::ISODate);
-    video->setPublished(publishedDateTime);
-
-    video->setChannelId(snippet[QLatin1String("channelId")].toString());
+    bool isLiveBroadcastContent = liveBroadcastContent != QLatin1String("none");
+    if (isLiveBroadcastContent) return;
 
-    video->setTitle(snippet[QLatin1String("title")].toString());
-    video->setDescription(snippet[QLatin1String("description")].toString());
-
-    QJsonObject thumbnails = snippet[QLatin1String("thumbnails")].toObject();
-    QLatin1String url("url");
-    video->setThumbnailUrl(thumbnails[QLatin1String("medium")].toObject()[url].toString());
-    video->setMediumThumbnailUrl(thumbnails[QLatin1String("high")].toObject()[url].toString());
-    video->setLargeThumbnailUrl(thumbnails[QLatin1String("standard")].toObject()[url].toString());
-
-    video->setChannelTitle(snippet[QLatin1String("channelTitle")].toString());
-
-    // These are only for "videos" requests
-
-    QJsonValue contentDetails = item[QLatin1String("contentDetails")];
-    if (contentDetails.isObject()) {
-        QString isoPeriod = contentDetails.toObject()[QLatin1String("duration")].toString();
-        int duration = DataUtils::parseIsoPeriod(isoPeriod);
-        video->setDuration(duration);
-    }
+    record.published = QDateTime::fromString(publishedAt, Qt::ISODate);
+    if (hasContentDetails) record.duration = DataUtils::parseIsoPeriod(isoPeriod);
+    if (hasStatistics) record.viewCount = viewCount.toInt();
+    records.append(record);
+}
 
-    QJsonValue statistics = item[QLatin1String("statistics")];
-    if (statistics.isObject()) {
-        int viewCount = statistics.toObject()[QLatin1String("viewCount")].toString().toInt();
-        video->setViewCount(viewCount);
+QString YT3ListParser::parseThumbnailUrl(JsonReader &reader) {
+    QString url;
+    if (!reader.beginObject()) return url;
+    while (reader.nextName()) {
+        if (reader.nameIs("url"))
+            url = reader.readString();
+        else
+            reader.skipValue();
     }
-
-    videos.append(video);
+    return url;
 }
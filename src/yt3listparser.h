@@ -3,18 +3,40 @@
 
 #include <QtCore>
 
-class Video;
+class JsonReader;
 
-class YT3ListParser : public QObject {
+// What a list response says about a video, before it becomes a Video
+struct YT3VideoRecord {
+    YT3VideoRecord() : duration(-1), viewCount(-1) {}
+    QString id;
+    QString title;
+    QString description;
+    QString channelId;
+    QString channelTitle;
+    QDateTime published;
+    QString thumbnailUrl;
+    QString mediumThumbnailUrl;
+    QString largeThumbnailUrl;
+    // These are only for "videos" requests, -1 when missing
+    int duration;
+    int viewCount;
+};
+
+// Parsing does not create any QObject and can run on any thread, see ParseUtils
+class YT3ListParser {
 public:
+    static YT3ListParser parse(const QByteArray &bytes) { return YT3ListParser(bytes); }
+
+    YT3ListParser() {}
     YT3ListParser(const QByteArray &bytes);
-    const QVector<Video *> &getVideos() { return videos; }
-    const QString &getNextPageToken() { return nextPageToken; }
+    const QVector<YT3VideoRecord> &getRecords() const { return records; }
+    const QString &getNextPageToken() const { return nextPageToken; }
 
 private:
-    void parseItem(const QJsonObject &item);
+    void parseItem(JsonReader &reader);
+    QString parseThumbnailUrl(JsonReader &reader);
 
-    QVector<Video *> videos;
+    QVector<YT3VideoRecord> records;
     QString nextPageToken;
 };
 
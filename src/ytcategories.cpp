@@ -24,6 +24,33 @@ $END_LICENSE */
 #include "datautils.h"
 #include "yt3.h"
 #include "ytregions.h"
+#include "parseutils.h"
+
+namespace {
+
+// Runs on the thread pool
+QVector<YTCategory> parseCategoryList(const QByteArray &bytes) {
+    QJsonDocument doc = QJsonDocument::fromJson(bytes);
+    QJsonObject obj = doc.object();
+    const QJsonArray items = obj["items"].toArray();
+
+    QVector<YTCategory> categories;
+    categories.reserve(items.size());
+    for (const QJsonValue &v : items) {
+        QJsonObject item = v.toObject();
+        QJsonObject snippet = item["snippet"].toObject();
+        bool isAssignable = snippet["assignable"].toBool();
+        if (!isAssignable) continue;
+
+        YTCategory category;
+        category.term = item["id"].toString();
+        category.label = snippet["title"].toString();
+        // if (category.label.startsWith(QLatin1String("News"))) continue;
+        categories << category;
+    }
+    return categories;
+}
+}
 
 YTCategories::YTCategories(QObject *parent) : QObject(parent) { }
 
@@ -52,26 +79,9 @@ void YTCategories::loadCategories(QString language) {
 }
 
 void YTCategories::parseCategories(const QByteArray &bytes) {
-    QJsonDocument doc = QJsonDocument::fromJson(bytes);
-    QJsonObject obj = doc.object();
-    const QJsonArray items = obj["items"].toArray();
-
-    QVector<YTCategory> categories;
-    categories.reserve(items.size());
-    for (const QJsonValue &v : items) {
-        QJsonObject item = v.toObject();
-        QJsonObject snippet = item["snippet"].toObject();
-        bool isAssignable = snippet["assignable"].toBool();
-        if (!isAssignable) continue;
-
-        YTCategory category;
-        category.term = item["id"].toString();
-        category.label = snippet["title"].toString();
-        // if (category.label.startsWith(QLatin1String("News"))) continue;
-        categories << category;
-    }
-
-    emit categoriesLoaded(categories);
+    ParseUtils::run(this, bytes, parseCategoryList, [this](const QVector<YTCategory> &categories) {
+        emit categoriesLoaded(categories);
+    });
 }
 
 void YTCategories::requestError(const QString &message) {
@@ -24,9 +24,39 @@ $END_LICENSE */
 #include "database.h"
 #include <QtSql>
 
-#include "yt3.h"
+#include "yt3batcher.h"
 
 #include "iconutils.h"
+#include "parseutils.h"
+
+namespace {
+
+struct ChannelInfo {
+    ChannelInfo() : found(false) {}
+    bool found;
+    QString displayName;
+    QString description;
+    QString thumbnailUrl;
+};
+
+// Runs on the thread pool
+ChannelInfo parseChannelInfo(const QByteArray &bytes) {
+    ChannelInfo info;
+    QJsonDocument doc = QJsonDocument::fromJson(bytes);
+    QJsonObject obj = doc.object();
+    const QJsonArray items = obj["items"].toArray();
+    for (const QJsonValue &v : items) {
+        QJsonObject item = v.toObject();
+        QJsonObject snippet = item["snippet"].toObject();
+        info.found = true;
+        info.displayName = snippet["title"].toString();
+        info.description = snippet["description"].toString();
+        QJsonObject thumbnails = snippet["thumbnails"].toObject();
+        info.thumbnailUrl = thumbnails["medium"].toObject()["url"].toString();
+    }
+    return info;
+}
+}
 
 YTChannel::YTChannel(const QString &channelId, QObject *parent) : QObject(parent),
     id(0),
@@ -86,34 +116,26 @@ void YTChannel::maybeLoadfromAPI() {
 
     loading = true;
 
-    QUrl url = YT3::instance().method("channels");
-    QUrlQuery q(url);
-    q.addQueryItem("id", channelId);
-    q.addQueryItem("part", "snippet");
-    url.setQuery(q);
-
-    QObject *reply = HttpUtils::yt().get(url);
+    // channels loading together share a single request
+    QObject *reply = YT3Batcher::instance().request(
+            QStringLiteral("channels"), QStringLiteral("snippet"), QStringList(channelId));
     connect(reply, SIGNAL(data(QByteArray)), SLOT(parseResponse(QByteArray)));
     connect(reply, SIGNAL(error(QString)), SLOT(requestError(QString)));
 }
 
 void YTChannel::parseResponse(const QByteArray &bytes) {
-    QJsonDocument doc = QJsonDocument::fromJson(bytes);
-    QJsonObject obj = doc.object();
-    const QJsonArray items = obj["items"].toArray();
-    for (const QJsonValue &v : items) {
-        QJsonObject item = v.toObject();
-        QJsonObject snippet = item["snippet"].toObject();
-        displayName = snippet["title"].toString();
-        description = snippet["description"].toString();
-        QJsonObject thumbnails = snippet["thumbnails"].toObject();
-        thumbnailUrl = thumbnails["medium"].toObject()["url"].toString();
-        qDebug() << displayName << description << thumbnailUrl;
-    }
-
-    emit infoLoaded();
-    storeInfo();
-    loading = false;
+    ParseUtils::run(this, bytes, parseChannelInfo, [this](const ChannelInfo &info) {
+        if (info.found) {
+            displayName = info.displayName;
+            description = info.description;
+            thumbnailUrl = info.thumbnailUrl;
+            qDebug() << displayName << description << thumbnailUrl;
+        }
+
+        emit infoLoaded();
+        storeInfo();
+        loading = false;
+    });
 }
 
 void YTChannel::loadThumbnail() {
@@ -30,6 +30,7 @@ $END_LICENSE */
 #include "mainwindow.h"
 #include "yt3.h"
 #include "yt3listparser.h"
+#include "parseutils.h"
 
 namespace {
 
@@ -46,6 +47,24 @@ YTSearch::YTSearch(SearchParams *searchParams, QObject *parent)
 void YTSearch::loadVideos(int max, int startIndex) {
     aborted = false;
 
+    QUrl url = firstPageUrl(max);
+
+    if (startIndex > 1) {
+        if (maybeReloadToken(max, startIndex)) return;
+        QUrlQuery q(url);
+        q.addQueryItem("pageToken", nextPageToken);
+        url.setQuery(q);
+    }
+
+    lastUrl = url;
+
+    // qWarning() << "YT3 search" << url.toString();
+    QObject *reply = request(url);
+    connect(reply, SIGNAL(data(QByteArray)), SLOT(parseResults(QByteArray)));
+    connect(reply, SIGNAL(error(QString)), SLOT(requestError(QString)));
+}
+
+QUrl YTSearch::firstPageUrl(int max) const {
     QUrl url = YT3::instance().method("search");
 
     QUrlQuery q(url);
@@ -53,11 +72,6 @@ void YTSearch::loadVideos(int max, int startIndex) {
     q.addQueryItem("type", "video");
     q.addQueryItem("maxResults", QString::number(max));
 
-    if (startIndex > 1) {
-        if (maybeReloadToken(max, startIndex)) return;
-        q.addQueryItem("pageToken", nextPageToken);
-    }
-
     // TODO interesting params
     // urlHelper.addQueryItem("videoSyndicated", "true");
     // urlHelper.addQueryItem("regionCode", "IT");
@@ -135,24 +149,26 @@ void YTSearch::loadVideos(int max, int startIndex) {
     }
 
     url.setQuery(q);
-
-    lastUrl = url;
-
-    // qWarning() << "YT3 search" << url.toString();
-    QObject *reply = HttpUtils::yt().get(url);
-    connect(reply, SIGNAL(data(QByteArray)), SLOT(parseResults(QByteArray)));
-    connect(reply, SIGNAL(error(QString)), SLOT(requestError(QString)));
+    return url;
 }
 
 void YTSearch::parseResults(const QByteArray &data) {
     if (aborted) return;
+    const uint generation = this->generation;
+    ParseUtils::run(this, data, YT3ListParser::parse,
+                    [this, generation](const YT3ListParser &parser) {
+                        if (generation == this->generation) loadResults(parser);
+                    });
+}
 
-    YT3ListParser parser(data);
-    const QVector<Video *> &videos = parser.getVideos();
+void YTSearch::loadResults(const YT3ListParser &parser) {
+    if (aborted) return;
 
     bool tryingWithNewToken = setPageToken(parser.getNextPageToken());
     if (tryingWithNewToken) return;
 
+    const QVector<Video *> videos = createVideos(parser);
+
     if (name.isEmpty() && !searchParams->channelId().isEmpty()) {
         if (!videos.isEmpty()) {
             name = videos.at(0)->getChannelTitle();
@@ -172,6 +188,7 @@ void YTSearch::parseResults(const QByteArray &data) {
 
 void YTSearch::abort() {
     aborted = true;
+    abortRequests();
 }
 
 QString YTSearch::getName() {
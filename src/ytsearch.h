@@ -26,6 +26,7 @@ $END_LICENSE */
 
 class SearchParams;
 class Video;
+class YT3ListParser;
 
 class YTSearch : public PaginatedVideoSource {
     Q_OBJECT
@@ -33,6 +34,8 @@ class YTSearch : public PaginatedVideoSource {
 public:
     YTSearch(SearchParams *params, QObject *parent = 0);
     void loadVideos(int max, int startIndex);
+    // What loadVideos() requests for the first page
+    QUrl firstPageUrl(int max) const;
     void abort();
     QString getName();
     const QList<QAction *> &getActions();
@@ -47,6 +50,8 @@ private slots:
     void requestError(const QString &message);
 
 private:
+    void loadResults(const YT3ListParser &parser);
+
     SearchParams *searchParams;
     bool aborted;
     QString name;
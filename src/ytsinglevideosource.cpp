@@ -25,6 +25,7 @@ $END_LICENSE */
 
 #include "yt3.h"
 #include "yt3listparser.h"
+#include "parseutils.h"
 
 YTSingleVideoSource::YTSingleVideoSource(QObject *parent) : PaginatedVideoSource(parent),
     video(0),
@@ -75,20 +76,28 @@ void YTSingleVideoSource::loadVideos(int max, int startIndex) {
 
     lastUrl = url;
 
-    QObject *reply = HttpUtils::yt().get(url);
+    QObject *reply = request(url);
     connect(reply, SIGNAL(data(QByteArray)), SLOT(parseResults(QByteArray)));
     connect(reply, SIGNAL(error(QString)), SLOT(requestError(QString)));
 }
 
 void YTSingleVideoSource::parseResults(QByteArray data) {
     if (aborted) return;
+    const uint generation = this->generation;
+    ParseUtils::run(this, data, YT3ListParser::parse,
+                    [this, generation](const YT3ListParser &parser) {
+                        if (generation == this->generation) loadResults(parser);
+                    });
+}
 
-    YT3ListParser parser(data);
-    const QVector<Video*> &videos = parser.getVideos();
+void YTSingleVideoSource::loadResults(const YT3ListParser &parser) {
+    if (aborted) return;
 
     bool tryingWithNewToken = setPageToken(parser.getNextPageToken());
     if (tryingWithNewToken) return;
 
+    const QVector<Video*> videos = createVideos(parser);
+
     if (asyncDetails) {
         emit gotVideos(videos);
         if (startIndex == 2) emit finished(videos.size() + 1);
@@ -99,6 +108,7 @@ void YTSingleVideoSource::parseResults(QByteArray data) {
 
 void YTSingleVideoSource::abort() {
     aborted = true;
+    abortRequests();
 }
 
 QString YTSingleVideoSource::getName() {
@@ -24,6 +24,8 @@ $END_LICENSE */
 #include <QtNetwork>
 #include "paginatedvideosource.h"
 
+class YT3ListParser;
+
 class YTSingleVideoSource : public PaginatedVideoSource {
 
     Q_OBJECT
@@ -42,6 +44,8 @@ private slots:
     void requestError(const QString &message);
 
 private:
+    void loadResults(const YT3ListParser &parser);
+
     Video *video;
     QString videoId;
     bool aborted;
@@ -25,6 +25,7 @@ $END_LICENSE */
 
 #include "yt3.h"
 #include "yt3listparser.h"
+#include "parseutils.h"
 
 YTStandardFeed::YTStandardFeed(QObject *parent)
     : PaginatedVideoSource(parent),
@@ -33,14 +34,27 @@ YTStandardFeed::YTStandardFeed(QObject *parent)
 void YTStandardFeed::loadVideos(int max, int startIndex) {
     aborted = false;
 
-    QUrl url = YT3::instance().method("videos");
+    QUrl url = firstPageUrl(max);
 
-    QUrlQuery q(url);
     if (startIndex > 1) {
         if (maybeReloadToken(max, startIndex)) return;
+        QUrlQuery q(url);
         q.addQueryItem("pageToken", nextPageToken);
+        url.setQuery(q);
     }
 
+    lastUrl = url;
+
+    QObject *reply = request(url);
+    qDebug() << url;
+    connect(reply, SIGNAL(data(QByteArray)), SLOT(parseResults(QByteArray)));
+    connect(reply, SIGNAL(error(QString)), SLOT(requestError(QString)));
+}
+
+QUrl YTStandardFeed::firstPageUrl(int max) const {
+    QUrl url = YT3::instance().method("videos");
+
+    QUrlQuery q(url);
     q.addQueryItem("part", "snippet,contentDetails,statistics");
     q.addQueryItem("chart", "mostPopular");
 
@@ -53,18 +67,20 @@ void YTStandardFeed::loadVideos(int max, int startIndex) {
     q.addQueryItem("maxResults", QString::number(max));
 
     url.setQuery(q);
-
-    QObject *reply = HttpUtils::yt().get(url);
-    qDebug() << url;
-    connect(reply, SIGNAL(data(QByteArray)), SLOT(parseResults(QByteArray)));
-    connect(reply, SIGNAL(error(QString)), SLOT(requestError(QString)));
+    return url;
 }
 
 void YTStandardFeed::parseResults(QByteArray data) {
     if (aborted) return;
+    const uint generation = this->generation;
+    ParseUtils::run(this, data, YT3ListParser::parse,
+                    [this, generation](const YT3ListParser &parser) {
+                        if (generation == this->generation) loadResults(parser);
+                    });
+}
 
-    YT3ListParser parser(data);
-    const QVector<Video*> &videos = parser.getVideos();
+void YTStandardFeed::loadResults(const YT3ListParser &parser) {
+    if (aborted) return;
 
     bool tryingWithNewToken = setPageToken(parser.getNextPageToken());
     if (tryingWithNewToken) return;
@@ -76,12 +92,15 @@ void YTStandardFeed::parseResults(QByteArray data) {
         return;
     }
 
+    // only now, so that pages thrown away for an expired token don't leak videos
+    const QVector<Video*> videos = createVideos(parser);
     emit gotVideos(videos);
     emit finished(videos.size());
 }
 
 void YTStandardFeed::abort() {
     aborted = true;
+    abortRequests();
 }
 
 void YTStandardFeed::requestError(const QString &message) {
@@ -24,6 +24,8 @@ $END_LICENSE */
 #include <QtNetwork>
 #include "paginatedvideosource.h"
 
+class YT3ListParser;
+
 class YTStandardFeed : public PaginatedVideoSource {
 
     Q_OBJECT
@@ -47,6 +49,8 @@ public:
     void setTime(const QString &value) { time = value; }
 
     void loadVideos(int max, int startIndex);
+    // What loadVideos() requests for the first page
+    QUrl firstPageUrl(int max) const;
     void abort();
     QString getName() { return label; }
 
@@ -55,6 +59,8 @@ private slots:
     void requestError(const QString &message);
 
 private:
+    void loadResults(const YT3ListParser &parser);
+
     QString feedId;
     QString regionId;
     QString category;
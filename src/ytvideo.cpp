@@ -4,20 +4,87 @@
 #include "http.h"
 #include "httputils.h"
 #include "jsfunctions.h"
+#include "signaturedecryptor.h"
 #include "temporary.h"
 #include "videodefinition.h"
 
-#include <QJSEngine>
-#include <QJSValue>
 #include <QtNetwork>
+#include <algorithm>
 
 namespace {
-static const QString jsNameChars = "a-zA-Z0-9\\$_";
+// "el" parameters of get_video_info, the last one is the special embedded form
+const int elVariants = 5;
+// get_video_info requests started at once
+const int raceWidth = 3;
+// Matches can span chunks of the watch page, this much of what was already scanned is scanned
+// again. Longer matches are still found by scrapeWebPage() once the whole page is there.
+const int webPageOverlap = 64 * 1024;
+
+bool wantsDashManifest() {
+#ifdef APP_DASH
+    return QSettings().value("definition", "360p").toString() == QLatin1String("1080p");
+#else
+    return false;
+#endif
+}
+
+const QRegExp &dashManifestRE() {
+    static const QRegExp re("\"dashmpd\":\\s*\"([^\"]+)\"");
+    return re;
+}
 }
 
 YTVideo::YTVideo(const QString &videoId, QObject *parent)
     : QObject(parent), videoId(videoId), definitionCode(0), elIndex(0), ageGate(false),
-      loadingStreamUrl(false) {}
+      loadingStreamUrl(false), idlePriority(false), raceNext(0), webPageDecoder(0),
+      webPageHasFmtMap(false), webPageHasJsPlayer(false), webPageHasDashManifest(false) {}
+
+YTVideo::~YTVideo() {
+    delete webPageDecoder;
+}
+
+void YTVideo::setIdlePriority(bool value) {
+    if (idlePriority == value) return;
+    idlePriority = value;
+    // move what is still queued
+    const HttpRequest::Priority priority =
+            idlePriority ? HttpRequest::IdlePriority : HttpRequest::NormalPriority;
+    for (const QPointer<QObject> &p : replies) {
+        HttpReply *reply = qobject_cast<HttpReply *>(p.data());
+        if (reply) HttpUtils::yt().setPriority(reply->url(), priority);
+    }
+}
+
+void YTVideo::abort() {
+    const QVector<QPointer<QObject>> aborted = replies;
+    replies.clear();
+    raceReplies.clear();
+    for (const QPointer<QObject> &p : aborted) {
+        if (!p) continue;
+        disconnect(p, 0, this, 0);
+        HttpReply *reply = qobject_cast<HttpReply *>(p.data());
+        if (reply) reply->abort();
+    }
+    loadingStreamUrl = false;
+}
+
+QObject *YTVideo::request(const HttpRequest &req) {
+    HttpRequest scheduledReq = req;
+    if (idlePriority) scheduledReq.priority = HttpRequest::IdlePriority;
+    QObject *reply = HttpUtils::yt().request(scheduledReq);
+
+    // forget the finished ones
+    for (int i = replies.size() - 1; i >= 0; --i)
+        if (!replies.at(i)) replies.remove(i);
+    replies << reply;
+    return reply;
+}
+
+QObject *YTVideo::get(const QUrl &url) {
+    HttpRequest req;
+    req.url = url;
+    return request(req);
+}
 
 void YTVideo::loadStreamUrl() {
     if (loadingStreamUrl) {
@@ -28,14 +95,54 @@ void YTVideo::loadStreamUrl() {
     elIndex = 0;
     ageGate = false;
 
-    getVideoInfo();
+    raceOrder = rankedElVariants();
+    raceNext = 0;
+    raceVideoInfo();
 }
 
-void YTVideo::getVideoInfo() {
+QVector<int> YTVideo::rankedElVariants() {
+    const QVector<int> &successes = elSuccesses();
+    QVector<int> variants;
+    for (int i = 0; i < elVariants; ++i)
+        variants << i;
+    // most successful first, in the historical order otherwise
+    std::stable_sort(variants.begin(), variants.end(),
+                     [&successes](int a, int b) { return successes.at(a) > successes.at(b); });
+    return variants;
+}
+
+QVector<int> &YTVideo::elSuccesses() {
+    static QVector<int> successes;
+    if (successes.isEmpty()) {
+        const QVariantList values = QSettings().value("elSuccesses").toList();
+        for (int i = 0; i < elVariants; ++i)
+            successes << (i < values.size() ? values.at(i).toInt() : 0);
+    }
+    return successes;
+}
+
+void YTVideo::recordElSuccess(int el) {
+    QVector<int> &successes = elSuccesses();
+    successes[el]++;
+    int total = 0;
+    for (int value : successes)
+        total += value;
+    // older results count less and less, so that we follow what YouTube does now
+    if (total > 200) {
+        for (int &value : successes)
+            value /= 2;
+    }
+    QVariantList values;
+    for (int value : successes)
+        values << value;
+    QSettings().setValue("elSuccesses", values);
+}
+
+QUrl YTVideo::videoInfoUrl(int el) const {
     static const QStringList elTypes = {"&el=embedded", "&el=detailpage", "&el=vevo", ""};
 
     QUrl url;
-    if (elIndex == elTypes.size()) {
+    if (el == elTypes.size()) {
         // qDebug() << "Trying special embedded el param";
         url = QUrl("https://www.youtube.com/get_video_info");
         QUrlQuery q;
@@ -47,26 +154,80 @@ void YTVideo::getVideoInfo() {
         q.addQueryItem("asv", "3");
         q.addQueryItem("sts", "1588");
         url.setQuery(q);
-    } else if (elIndex > elTypes.size() - 1) {
+    } else {
+        // qDebug() << "Trying el param:" << elTypes.at(el) << el;
+        url = QUrl(QString("https://www.youtube.com/"
+                           "get_video_info?video_id=%1%2&ps=default&eurl=&gl=US&hl=en")
+                           .arg(videoId, elTypes.at(el)));
+    }
+    return url;
+}
+
+void YTVideo::getVideoInfo() {
+    if (elIndex > elVariants - 1) {
         qWarning() << "Cannot get video info";
         loadingStreamUrl = false;
         emit errorStreamUrl("Cannot get video info");
         return;
-    } else {
-        // qDebug() << "Trying el param:" << elTypes.at(elIndex) << elIndex;
-        url = QUrl(QString("https://www.youtube.com/"
-                           "get_video_info?video_id=%1%2&ps=default&eurl=&gl=US&hl=en")
-                           .arg(videoId, elTypes.at(elIndex)));
     }
 
-    QObject *reply = HttpUtils::yt().get(url);
+    QObject *reply = get(videoInfoUrl(elIndex));
     connect(reply, SIGNAL(data(QByteArray)), SLOT(gotVideoInfo(QByteArray)));
     connect(reply, SIGNAL(error(QString)), SLOT(errorVideoInfo(QString)));
 
     // see you in gotVideoInfo...
 }
 
+void YTVideo::raceVideoInfo() {
+    raceReplies.clear();
+    while (raceNext < raceOrder.size() && raceReplies.size() < raceWidth) {
+        const int el = raceOrder.at(raceNext++);
+        QObject *reply = get(videoInfoUrl(el));
+        raceReplies.insert(el, reply);
+        connect(reply, SIGNAL(data(QByteArray)), SLOT(gotVideoInfo(QByteArray)));
+        connect(reply, SIGNAL(error(QString)), SLOT(errorVideoInfo(QString)));
+    }
+
+    if (raceReplies.isEmpty()) {
+        qWarning() << "Cannot get video info";
+        loadingStreamUrl = false;
+        emit errorStreamUrl("Cannot get video info");
+    }
+
+    // see you in gotVideoInfo...
+}
+
+int YTVideo::takeRaceReply(QObject *reply) {
+    for (auto i = raceReplies.begin(); i != raceReplies.end(); ++i) {
+        if (i.value() == reply) {
+            const int el = i.key();
+            raceReplies.erase(i);
+            return el;
+        }
+    }
+    return -1;
+}
+
+void YTVideo::raceVariantFailed() {
+    // wait for the others, then try the next ones
+    if (raceReplies.isEmpty()) raceVideoInfo();
+}
+
+void YTVideo::abortRace() {
+    const QMap<int, QPointer<QObject>> replies = raceReplies;
+    raceReplies.clear();
+    for (const QPointer<QObject> &p : replies) {
+        if (!p) continue;
+        disconnect(p, 0, this, 0);
+        HttpReply *reply = qobject_cast<HttpReply *>(p.data());
+        if (reply) reply->abort();
+    }
+}
+
 void YTVideo::gotVideoInfo(const QByteArray &bytes) {
+    // -1 when not racing, e.g. after scraping the web page
+    const int el = takeRaceReply(sender());
+
     QString videoInfo = QString::fromUtf8(bytes);
     // qDebug() << "videoInfo" << videoInfo;
 
@@ -74,6 +235,10 @@ void YTVideo::gotVideoInfo(const QByteArray &bytes) {
     static const QRegExp videoTokeRE(JsFunctions::instance()->videoTokenRE());
     if (videoTokeRE.indexIn(videoInfo) == -1) {
         qDebug() << "Cannot get token. Trying next el param" << videoInfo << videoTokeRE.pattern();
+        if (el != -1) {
+            raceVariantFailed();
+            return;
+        }
         // Don't panic! We're gonna try another magic "el" param
         elIndex++;
         getVideoInfo();
@@ -81,22 +246,34 @@ void YTVideo::gotVideoInfo(const QByteArray &bytes) {
     }
 
     QString videoToken = videoTokeRE.cap(1);
-    qDebug() << "got token" << videoToken;
-    while (videoToken.contains('%'))
-        videoToken = QByteArray::fromPercentEncoding(videoToken.toLatin1());
-    qDebug() << "videoToken" << videoToken;
-    this->videoToken = videoToken;
 
     // get fmt_url_map
     static const QRegExp fmtMapRE(JsFunctions::instance()->videoInfoFmtMapRE());
     if (fmtMapRE.indexIn(videoInfo) == -1) {
         qDebug() << "Cannot get urlMap. Trying next el param";
+        if (el != -1) {
+            raceVariantFailed();
+            return;
+        }
         // Don't panic! We're gonna try another magic "el" param
         elIndex++;
         getVideoInfo();
         return;
     }
 
+    if (el != -1) {
+        // we have a winner
+        abortRace();
+        elIndex = el;
+        recordElSuccess(el);
+    }
+
+    qDebug() << "got token" << videoToken;
+    while (videoToken.contains('%'))
+        videoToken = QByteArray::fromPercentEncoding(videoToken.toLatin1());
+    qDebug() << "videoToken" << videoToken;
+    this->videoToken = videoToken;
+
     QString fmtUrlMap = fmtMapRE.cap(1);
     // qDebug() << "got fmtUrlMap" << fmtUrlMap;
     fmtUrlMap = QByteArray::fromPercentEncoding(fmtUrlMap.toUtf8());
@@ -142,18 +319,8 @@ void YTVideo::parseFmtUrlMap(const QString &fmtUrlMap, bool fromWebPage) {
                         if (sig.isEmpty()) sig = JsFunctions::instance()->decryptSignature(sig);
                     }
                 } else {
-                    QUrl url("https://www.youtube.com/watch");
-                    QUrlQuery q;
-                    q.addQueryItem("v", videoId);
-                    q.addQueryItem("gl", "US");
-                    q.addQueryItem("hl", "en");
-                    q.addQueryItem("has_verified", "1");
-                    url.setQuery(q);
-                    qDebug() << "Loading webpage" << url;
-                    QObject *reply = HttpUtils::yt().get(url);
-                    connect(reply, SIGNAL(data(QByteArray)), SLOT(scrapeWebPage(QByteArray)));
-                    connect(reply, SIGNAL(error(QString)), SLOT(errorVideoInfo(QString)));
-                    // see you in scrapWebPage(QByteArray)
+                    loadWebPage();
+                    // see you in scanWebPage(QByteArray)
                     return;
                 }
             }
@@ -190,13 +357,76 @@ void YTVideo::parseFmtUrlMap(const QString &fmtUrlMap, bool fromWebPage) {
 }
 
 void YTVideo::errorVideoInfo(const QString &message) {
+    if (takeRaceReply(sender()) != -1) {
+        qDebug() << message;
+        raceVariantFailed();
+        return;
+    }
     loadingStreamUrl = false;
     emit errorStreamUrl(message);
 }
 
+void YTVideo::loadWebPage() {
+    QUrl url("https://www.youtube.com/watch");
+    QUrlQuery q;
+    q.addQueryItem("v", videoId);
+    q.addQueryItem("gl", "US");
+    q.addQueryItem("hl", "en");
+    q.addQueryItem("has_verified", "1");
+    url.setQuery(q);
+    qDebug() << "Loading webpage" << url;
+
+    HttpRequest req;
+    req.url = url;
+    req.streaming = true;
+    QObject *reply = request(req);
+    webPageReply = reply;
+    webPage.clear();
+    webPageHasFmtMap = false;
+    webPageHasJsPlayer = false;
+    // nothing to wait for unless we are going to use it
+    webPageHasDashManifest = !wantsDashManifest();
+    delete webPageDecoder;
+    webPageDecoder = QTextCodec::codecForName("UTF-8")->makeDecoder();
+    connect(reply, SIGNAL(chunk(QByteArray)), SLOT(scanWebPage(QByteArray)));
+    connect(reply, SIGNAL(data(QByteArray)), SLOT(scrapeWebPage(QByteArray)));
+    connect(reply, SIGNAL(error(QString)), SLOT(errorVideoInfo(QString)));
+}
+
+void YTVideo::scanWebPage(const QByteArray &bytes) {
+    const int scanned = webPage.size();
+    webPage += webPageDecoder->toUnicode(bytes);
+    // only the new text, the page can be half a megabyte
+    const int from = qMax(0, scanned - webPageOverlap);
+
+    // What we need is near the top of the page, don't wait for the rest of it
+    static const QRegExp ageGateRE(JsFunctions::instance()->ageGateRE());
+    static const QRegExp fmtMapRE(JsFunctions::instance()->webPageFmtMapRE());
+    static const QRegExp jsPlayerRe(JsFunctions::instance()->jsPlayerRE());
+    if (ageGateRE.indexIn(webPage, from) == -1) {
+        if (!webPageHasFmtMap) webPageHasFmtMap = fmtMapRE.indexIn(webPage, from) != -1;
+        if (!webPageHasJsPlayer) webPageHasJsPlayer = jsPlayerRe.indexIn(webPage, from) != -1;
+        if (!webPageHasDashManifest)
+            webPageHasDashManifest = dashManifestRE().indexIn(webPage, from) != -1;
+        if (!webPageHasFmtMap || !webPageHasJsPlayer || !webPageHasDashManifest) return;
+    }
+
+    if (webPageReply) {
+        disconnect(webPageReply, 0, this, 0);
+        HttpReply *reply = qobject_cast<HttpReply *>(webPageReply.data());
+        if (reply) reply->abort();
+    }
+    const QString html = webPage;
+    webPage.clear();
+    parseWebPage(html);
+}
+
 void YTVideo::scrapeWebPage(const QByteArray &bytes) {
-    const QString html = QString::fromUtf8(bytes);
+    webPage.clear();
+    parseWebPage(QString::fromUtf8(bytes));
+}
 
+void YTVideo::parseWebPage(const QString &html) {
     static const QRegExp ageGateRE(JsFunctions::instance()->ageGateRE());
     if (ageGateRE.indexIn(html) != -1) {
         // qDebug() << "Found ageGate";
@@ -223,7 +453,7 @@ void YTVideo::scrapeWebPage(const QByteArray &bytes) {
     QSettings settings;
     QString definitionName = settings.value("definition", "360p").toString();
     if (definitionName == QLatin1String("1080p")) {
-        QRegExp dashManifestRe("\"dashmpd\":\\s*\"([^\"]+)\"");
+        QRegExp dashManifestRe = dashManifestRE();
         if (dashManifestRe.indexIn(html) != -1) {
             dashManifestUrl = dashManifestRe.cap(1);
             dashManifestUrl.remove('\\');
@@ -242,7 +472,7 @@ void YTVideo::scrapeWebPage(const QByteArray &bytes) {
 
     static const QRegExp jsPlayerRe(JsFunctions::instance()->jsPlayerRE());
     if (jsPlayerRe.indexIn(html) != -1) {
-        QString jsPlayerUrl = jsPlayerRe.cap(1);
+        jsPlayerUrl = jsPlayerRe.cap(1);
         jsPlayerUrl.remove('\\');
         if (jsPlayerUrl.startsWith(QLatin1String("//"))) {
             jsPlayerUrl = QLatin1String("https:") + jsPlayerUrl;
@@ -255,28 +485,26 @@ void YTVideo::scrapeWebPage(const QByteArray &bytes) {
                     jsPlayerIdRe.indexIn(jsPlayerUrl);
                     QString jsPlayerId = jsPlayerRe.cap(1);
                     */
-        QObject *reply = HttpUtils::yt().get(jsPlayerUrl);
+
+        // the player is the same for many videos, don't download and scan it every time
+        decryptor = SignatureDecryptor::forPlayer(jsPlayerUrl);
+        if (decryptor) {
+            QTimer::singleShot(0, this, SLOT(jsPlayerReady()));
+            return;
+        }
+
+        QObject *reply = get(jsPlayerUrl);
         connect(reply, SIGNAL(data(QByteArray)), SLOT(parseJsPlayer(QByteArray)));
         connect(reply, SIGNAL(error(QString)), SLOT(errorVideoInfo(QString)));
     }
 }
 
 void YTVideo::parseJsPlayer(const QByteArray &bytes) {
-    jsPlayer = QString::fromUtf8(bytes);
-    // qDebug() << "jsPlayer" << jsPlayer;
-
-    // QRegExp funcNameRe("[\"']signature[\"']\\s*,\\s*([" + jsNameChars + "]+)\\(");
-    static const QRegExp funcNameRe(
-            JsFunctions::instance()->signatureFunctionNameRE().arg(jsNameChars));
-
-    if (funcNameRe.indexIn(jsPlayer) == -1) {
-        qWarning() << "Cannot capture signature function name" << jsPlayer;
-    } else {
-        sigFuncName = funcNameRe.cap(1);
-        captureFunction(sigFuncName, jsPlayer);
-        // qWarning() << sigFunctions << sigObjects;
-    }
+    decryptor = SignatureDecryptor::create(jsPlayerUrl, QString::fromUtf8(bytes));
+    jsPlayerReady();
+}
 
+void YTVideo::jsPlayerReady() {
 #ifdef APP_DASH
     if (!dashManifestUrl.isEmpty()) {
         QRegExp sigRe("/s/([\\w\\.]+)");
@@ -295,7 +523,7 @@ void YTVideo::parseJsPlayer(const QByteArray &bytes) {
                 loadingStreamUrl = false;
             } else {
                 // download the manifest
-                QObject *reply = HttpUtils::yt().get(QUrl::fromEncoded(dashManifestUrl.toUtf8()));
+                QObject *reply = get(QUrl::fromEncoded(dashManifestUrl.toUtf8()));
                 connect(reply, SIGNAL(data(QByteArray)), SLOT(parseDashManifest(QByteArray)));
                 connect(reply, SIGNAL(error(QString)), SLOT(errorVideoInfo(QString)));
             }
@@ -320,106 +548,9 @@ void YTVideo::parseDashManifest(const QByteArray &bytes) {
     loadingStreamUrl = false;
 }
 
-void YTVideo::captureFunction(const QString &name, const QString &js) {
-    qDebug() << __PRETTY_FUNCTION__ << name;
-    const QString argsAndBody =
-            QLatin1String("\\s*\\([") + jsNameChars + QLatin1String(",\\s]*\\)\\s*\\{[^\\}]+\\}");
-    QString func;
-    QRegExp funcRe(QLatin1String("function\\s+") + QRegExp::escape(name) + argsAndBody);
-    if (funcRe.indexIn(js) != -1) {
-        func = funcRe.cap(0);
-    } else {
-        // try var foo = function(bar) { };
-        funcRe = QRegExp(QLatin1String("var\\s+") + QRegExp::escape(name) +
-                         QLatin1String("\\s*=\\s*function") + argsAndBody);
-        if (funcRe.indexIn(js) != -1) {
-            func = funcRe.cap(0);
-        } else {
-            // try ,gr= function(bar) { };
-            funcRe = QRegExp(QLatin1String("[,\\s;}\\.\\)](") + QRegExp::escape(name) +
-                             QLatin1String("\\s*=\\s*function") + argsAndBody + ")");
-            if (funcRe.indexIn(js) != -1) {
-                func = funcRe.cap(1);
-            } else {
-                qWarning() << "Cannot capture function" << name;
-                return;
-            }
-        }
-    }
-    sigFunctions.insert(name, func);
-
-    // capture inner functions
-    static const QRegExp invokedFuncRe(QLatin1String("[\\s=;\\(]([") + jsNameChars +
-                                       QLatin1String("]+)\\s*\\([") + jsNameChars +
-                                       QLatin1String(",\\s]+\\)"));
-    int pos = name.length() + 9;
-    while ((pos = invokedFuncRe.indexIn(func, pos)) != -1) {
-        QString funcName = invokedFuncRe.cap(1);
-        if (!sigFunctions.contains(funcName)) captureFunction(funcName, js);
-        pos += invokedFuncRe.matchedLength();
-    }
-
-    // capture referenced objects
-    static const QRegExp objRe(QLatin1String("[\\s=;\\(]([") + jsNameChars +
-                               QLatin1String("]+)\\.[") + jsNameChars + QLatin1String("]+"));
-    pos = name.length() + 9;
-    while ((pos = objRe.indexIn(func, pos)) != -1) {
-        QString objName = objRe.cap(1);
-        if (!sigObjects.contains(objName)) captureObject(objName, js);
-        pos += objRe.matchedLength();
-    }
-}
-
-void YTVideo::captureObject(const QString &name, const QString &js) {
-    QRegExp re(QLatin1String("var\\s+") + QRegExp::escape(name) +
-               QLatin1String("\\s*=\\s*\\{.*\\}\\s*;"));
-    re.setMinimal(true);
-    if (re.indexIn(js) == -1) {
-        qWarning() << "Cannot capture object" << name;
-        return;
-    }
-    QString obj = re.cap(0);
-    sigObjects.insert(name, obj);
-}
-
 QString YTVideo::decryptSignature(const QString &s) {
-    qDebug() << "decryptSignature" << sigFuncName << sigFunctions << sigObjects;
-    if (sigFuncName.isEmpty()) return QString();
-    QJSEngine engine;
-    for (const QString &f : sigObjects) {
-        QJSValue value = engine.evaluate(f);
-        if (value.isError()) qWarning() << "Error in" << f << value.toString();
-    }
-    for (const QString &f : sigFunctions) {
-        QJSValue value = engine.evaluate(f);
-        if (value.isError()) qWarning() << "Error in" << f << value.toString();
-    }
-    QString js = sigFuncName + "('" + s + "');";
-    QJSValue value = engine.evaluate(js);
-    bool error = false;
-    if (value.isUndefined()) {
-        qWarning() << "Undefined result for" << js;
-        error = true;
-    }
-    if (value.isError()) {
-        qWarning() << "Error in" << js << value.toString();
-        error = true;
-    }
-    if (error) {
-        QJSEngine engine2;
-        engine2.evaluate(jsPlayer);
-        value = engine2.evaluate(js);
-        if (value.isUndefined()) {
-            qWarning() << "Undefined result for" << js;
-            error = true;
-        }
-        if (value.isError()) {
-            qWarning() << "Error in" << js << value.toString();
-            error = true;
-        }
-    }
-    if (error) return QString();
-    return value.toString();
+    if (!decryptor) return QString();
+    return decryptor->decrypt(s);
 }
 
 void YTVideo::saveDefinitionForUrl(const QString &url, const VideoDefinition &definition) {
@@ -3,6 +3,8 @@
 
 #include <QtCore>
 
+class HttpRequest;
+class SignatureDecryptor;
 class VideoDefinition;
 
 class YTVideo : public QObject {
@@ -10,8 +12,13 @@ class YTVideo : public QObject {
 
 public:
     YTVideo(const QString &videoId, QObject *parent);
+    ~YTVideo();
     void loadStreamUrl();
     int getDefinitionCode() const { return definitionCode; }
+    // Requests only run when the network is otherwise idle, e.g. when resolving ahead of time.
+    // Switching it off also moves up the requests that are still queued.
+    void setIdlePriority(bool value);
+    void abort();
 
 signals:
     void gotStreamUrl(const QUrl &streamUrl);
@@ -20,15 +27,27 @@ signals:
 private slots:
     void gotVideoInfo(const QByteArray &bytes);
     void errorVideoInfo(const QString &message);
+    void scanWebPage(const QByteArray &bytes);
     void scrapeWebPage(const QByteArray &bytes);
     void parseJsPlayer(const QByteArray &bytes);
+    void jsPlayerReady();
     void parseDashManifest(const QByteArray &bytes);
 
 private:
+    QObject *request(const HttpRequest &req);
+    QObject *get(const QUrl &url);
+    static QVector<int> rankedElVariants();
+    static QVector<int> &elSuccesses();
+    static void recordElSuccess(int el);
+    QUrl videoInfoUrl(int el) const;
     void getVideoInfo();
+    void raceVideoInfo();
+    int takeRaceReply(QObject *reply);
+    void raceVariantFailed();
+    void abortRace();
+    void loadWebPage();
+    void parseWebPage(const QString &html);
     void parseFmtUrlMap(const QString &fmtUrlMap, bool fromWebPage = false);
-    void captureFunction(const QString &name, const QString &js);
-    void captureObject(const QString &name, const QString &js);
     QString decryptSignature(const QString &s);
     void saveDefinitionForUrl(const QString &url, const VideoDefinition &definition);
 
@@ -36,17 +55,30 @@ private:
     QUrl m_streamUrl;
     int definitionCode;
     bool loadingStreamUrl;
+    bool idlePriority;
     // current index for the elTypes list
     // needed to iterate on elTypes
     int elIndex;
     bool ageGate;
+    // elTypes indexes in the order they are raced, see raceVideoInfo()
+    QVector<int> raceOrder;
+    int raceNext;
+    QMap<int, QPointer<QObject>> raceReplies;
     QString videoToken;
     QString fmtUrlMap;
-    QString sigFuncName;
-    QHash<QString, QString> sigFunctions;
-    QHash<QString, QString> sigObjects;
     QString dashManifestUrl;
-    QString jsPlayer;
+    QString jsPlayerUrl;
+    QSharedPointer<SignatureDecryptor> decryptor;
+    QVector<QPointer<QObject>> replies;
+
+    // The web page is scanned as it arrives, see scanWebPage()
+    QPointer<QObject> webPageReply;
+    QTextDecoder *webPageDecoder;
+    QString webPage;
+    // What scanWebPage() has found so far
+    bool webPageHasFmtMap;
+    bool webPageHasJsPlayer;
+    bool webPageHasDashManifest;
 };
 
 #endif // YTVIDEO_H